@@ -38,6 +38,7 @@
 #define MOVEIT_OMPL_INTERFACE_CONSTRAINTS_LIBRARY_
 
 #include <moveit/ompl_interface/ompl_planning_context.h>
+#include <moveit/ompl_interface/detail/compact_state_storage.h>
 #include <moveit/kinematic_constraints/kinematic_constraint.h>
 #include <moveit/constraint_samplers/constraint_sampler_manager.h>
 #include <ompl/base/StateStorage.h>
@@ -105,11 +106,37 @@ public:
     return constraint_msg_;
   }
 
+  /// \brief The full precision storage of the states; NULL once the states are kept compact (see compactStates())
   const ompl::base::StateStoragePtr& getStateStorage() const
   {
     return state_storage_ptr_;
   }
 
+  /// \brief Replace the full precision states by a CompactStateStorage of precision \e precision.
+  /// The connectivity of the states is kept; the stored ompl::base::State instances are freed.
+  void compactStates(CompactStateStorage::Precision precision);
+
+  bool hasCompactStates() const
+  {
+    return compact_storage_.get() != NULL;
+  }
+
+  const CompactStateStoragePtr& getCompactStateStorage() const
+  {
+    return compact_storage_;
+  }
+
+  std::size_t getStateCount() const;
+
+  const ConstrainedStateMetadata& getMetadata(std::size_t index) const;
+
+  /// \brief Get state \e index. With full precision storage the stored state is returned;
+  /// with compact storage the state is decompressed into \e scratch, which is returned.
+  const ompl::base::State* getState(std::size_t index, ompl::base::State *scratch) const;
+
+  /// \brief Write the states and their connectivity to \e filename, in the format read by ConstraintApproximationStateStorage::load()
+  void storeStates(const std::string &filename) const;
+
   const std::string& getFilename() const
   {
     return ompldb_filename_;
@@ -123,12 +150,17 @@ protected:
 
   moveit_msgs::Constraints constraint_msg_;
 
+  ompl::base::StateSpacePtr space_;
   std::vector<int> space_signature_;
 
   std::string ompldb_filename_;
   ompl::base::StateStoragePtr state_storage_ptr_;
   ConstraintApproximationStateStorage *state_storage_;
   std::size_t milestones_;
+
+  /// \brief The states when they are kept compact; their metadata is then in compact_metadata_
+  CompactStateStoragePtr compact_storage_;
+  std::vector<ConstrainedStateMetadata> compact_metadata_;
 };
 
 struct ConstraintApproximationConstructionOptions
@@ -139,7 +171,9 @@ struct ConstraintApproximationConstructionOptions
     max_edge_length(std::numeric_limits<double>::infinity()),
     explicit_motions(false),
     explicit_points_resolution(0.0),
-    max_explicit_points(0)
+    max_explicit_points(0),
+    compact_states(false),
+    compact_precision(CompactStateStorage::UINT16)
   {
   }
 
@@ -150,6 +184,10 @@ struct ConstraintApproximationConstructionOptions
   bool explicit_motions;
   double explicit_points_resolution;
   unsigned int max_explicit_points;
+
+  /// \brief Keep the constructed states in a CompactStateStorage of precision \e compact_precision
+  bool compact_states;
+  CompactStateStorage::Precision compact_precision;
 };
 
 struct ConstraintApproximationConstructionResults
@@ -165,8 +203,16 @@ class ConstraintsLibrary
 {
 public:
 
-  ConstraintsLibrary(OMPLPlanningContext* pcontext, const constraint_samplers::ConstraintSamplerManagerPtr& csm) : pcontext_(pcontext), constraint_sampler_manager_(csm)
+  ConstraintsLibrary(OMPLPlanningContext* pcontext, const constraint_samplers::ConstraintSamplerManagerPtr& csm) : pcontext_(pcontext), constraint_sampler_manager_(csm),
+    compact_states_(false), compact_precision_(CompactStateStorage::UINT16)
+  {
+  }
+
+  /// \brief Keep the states of approximations loaded by loadConstraintApproximations() in a CompactStateStorage
+  void setCompactStates(bool flag, CompactStateStorage::Precision precision = CompactStateStorage::UINT16)
   {
+    compact_states_ = flag;
+    compact_precision_ = precision;
   }
 
   void loadConstraintApproximations(const std::string &path);
@@ -202,6 +248,8 @@ private:
   OMPLPlanningContext* pcontext_;
   constraint_samplers::ConstraintSamplerManagerPtr constraint_sampler_manager_;
   std::map<std::string, ConstraintApproximationPtr> constraint_approximations_;
+  bool compact_states_;
+  CompactStateStorage::Precision compact_precision_;
 
 };
 
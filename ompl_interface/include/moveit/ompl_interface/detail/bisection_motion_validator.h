@@ -0,0 +1,176 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_BISECTION_MOTION_VALIDATOR_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_BISECTION_MOTION_VALIDATOR_
+
+#include <ompl/base/MotionValidator.h>
+#include <ompl/base/SpaceInformation.h>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <vector>
+
+namespace ompl_interface
+{
+
+/** @class BisectionMotionValidator
+    @brief A discrete motion validator that checks the intermediate states of a segment in
+    bisection (van der Corput) order, so collisions anywhere along the segment are found early.
+    For state spaces with sequential interpolation (e.g., IK seeded along the motion), all intermediate
+    states of a segment are computed at once before they are checked.
+    The outcome of every checked segment is cached, keyed by the joint values of its endpoints in
+    the order they are given (only the second endpoint and the interior of a segment are checked, so
+    the reverse segment is a different entry).  Entries keep the endpoint values, which are compared
+    on lookup, so hash collisions are never answered with another segment's validity.  Segments that
+    are validated again (during planning, simplification or hybridization of parallel solutions) are
+    answered without collision checking.  The cache is split in shards with their own lock, so
+    planning threads rarely wait for each other; once it holds \e max_cache_size segments, new
+    segments are checked but not cached.  The cache is only valid while the scene and the validity
+    checker do not change; call clearCache() before each solve. */
+class BisectionMotionValidator : public ompl::base::MotionValidator
+{
+public:
+
+  BisectionMotionValidator(const ompl::base::SpaceInformationPtr &si, std::size_t max_cache_size = 250000);
+
+  virtual bool checkMotion(const ompl::base::State *s1, const ompl::base::State *s2) const;
+  virtual bool checkMotion(const ompl::base::State *s1, const ompl::base::State *s2, std::pair<ompl::base::State*, double> &last_valid) const;
+
+  /// \brief Forget all cached segments and reset the statistics
+  void clearCache();
+
+  /// \brief Number of segments answered from the cache since the last call to clearCache()
+  std::size_t getCacheHits() const;
+
+  /// \brief Number of state validity checks avoided by the cache since the last call to clearCache()
+  std::size_t getSavedStateChecks() const;
+
+  /// \brief Number of state validity checks performed since the last call to clearCache()
+  std::size_t getPerformedStateChecks() const;
+
+  /// \brief Number of segments currently stored in the cache
+  std::size_t getCacheSize() const;
+
+  /// \brief Estimate of the bytes used by the cache: its entries and its bucket array
+  std::size_t getCacheMemoryUsage() const;
+
+protected:
+
+  struct SegmentKey
+  {
+    std::size_t first;
+    std::size_t second;
+
+    bool operator==(const SegmentKey &o) const
+    {
+      return first == o.first && second == o.second;
+    }
+  };
+
+  struct SegmentKeyHash
+  {
+    std::size_t operator()(const SegmentKey &k) const;
+  };
+
+  struct SegmentResult
+  {
+    bool valid;
+    int segments;
+    // for invalid segments, the last valid fraction along the segment
+    double last_valid;
+    // the values of both endpoints, first then second
+    std::vector<double> endpoints;
+  };
+
+  /// \brief Fingerprint of the joint values of a state
+  std::size_t fingerprint(const ompl::base::State *state) const;
+
+  /// \brief Look up the segment from \e s1 to \e s2. Returns false if it is not cached.
+  bool lookup(const SegmentKey &key, const ompl::base::State *s1, const ompl::base::State *s2, SegmentResult &result) const;
+
+  /// \brief Cache \e result for the segment from \e s1 to \e s2; the endpoint values are filled in
+  void store(const SegmentKey &key, const ompl::base::State *s1, const ompl::base::State *s2, SegmentResult &result) const;
+
+  /// \brief Build the cache key of the segment from \e s1 to \e s2
+  void makeKey(const ompl::base::State *s1, const ompl::base::State *s2, SegmentKey &key) const;
+
+  /// \brief Check the states at indices 1..nd of a segment split in \e nd parts (index nd is \e s2) in bisection order.
+  /// If \e first_invalid is not NULL, it is set to the index of the first invalid state along the segment.
+  /// The number of validity checks that were performed is added to \e performed.
+  bool checkSegment(const ompl::base::State *s1, const ompl::base::State *s2, int nd, int *first_invalid, std::size_t &performed) const;
+
+  /// \brief Return intermediate state \e j of a segment split in \e nd parts: the precomputed state in
+  /// \e segment, if any, or \e test, interpolated
+  const ompl::base::State* getIntermediateState(const ompl::base::State *s1, const ompl::base::State *s2, int j, int nd,
+                                                ompl::base::State *test, const std::vector<ompl::base::State*> &segment) const;
+
+  /// \brief Check an intermediate state; states the state space marked invalid during interpolation are not checked again
+  bool isIntermediateValid(const ompl::base::State *state) const;
+
+  void recordChecks(std::size_t performed, std::size_t saved, bool hit) const;
+
+  /// \brief Number of independently locked parts of the cache
+  static const unsigned int CACHE_SHARDS = 16;
+
+  typedef boost::unordered_map<SegmentKey, SegmentResult, SegmentKeyHash> SegmentMap;
+
+  struct CacheShard
+  {
+    SegmentMap   segments;
+    boost::mutex lock;
+  };
+
+  /// \brief The shard that holds the segment of \e key
+  CacheShard& getShard(const SegmentKey &key) const;
+
+  ompl::base::StateSpace *state_space_;
+  unsigned int variable_count_;
+  bool sequential_interpolation_;
+  std::size_t max_cache_size_;
+
+  mutable CacheShard shards_[CACHE_SHARDS];
+  /// \brief Number of segments stored over all shards
+  mutable boost::atomic<std::size_t> cache_size_;
+
+  mutable boost::atomic<std::size_t> cache_hits_;
+  mutable boost::atomic<std::size_t> saved_checks_;
+  mutable boost::atomic<std::size_t> performed_checks_;
+};
+
+typedef std::shared_ptr<BisectionMotionValidator> BisectionMotionValidatorPtr;
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_COMPACT_STATE_STORAGE_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_COMPACT_STATE_STORAGE_
+
+#include "moveit/ompl_interface/parameterization/model_based_state_space.h"
+#include <boost/cstdint.hpp>
+#include <vector>
+
+namespace ompl_interface
+{
+
+MOVEIT_CLASS_FORWARD(CompactStateStorage);
+
+/** @class CompactStateStorage
+    @brief Storage for large collections of states of a ModelBasedStateSpace at reduced precision.
+    Only the tag and the joint values of each state are kept; validity flags, distance and cost are
+    not.  States are decompressed into a full state by getState().
+
+    With FLOAT32, each value is stored as a float: 4 bytes per value and a relative error of at most
+    2^-24 (about 1.9e-7 rad for a joint at pi).  With UINT16, each value is quantized to 65536 levels
+    across the bounds of its variable: 2 bytes per value and an absolute error of at most half a
+    level, (max - min) / 131070 (about 5e-5 rad for a joint with a 2 pi range).  Values outside the
+    bounds are clamped to them.  Continuous joints are quantized over [-pi, pi], after wrapping their
+    values into that range.  UINT16 needs finite bounds for all other variables; if they are not,
+    FLOAT32 is used instead.  getMaxError() reports the bound for each variable. */
+class CompactStateStorage
+{
+public:
+
+  enum Precision
+  {
+    FLOAT32,
+    UINT16
+  };
+
+  CompactStateStorage(const ModelBasedStateSpacePtr &space, Precision precision);
+
+  /// \brief The precision actually used (UINT16 may have been replaced by FLOAT32)
+  Precision getPrecision() const
+  {
+    return precision_;
+  }
+
+  const ModelBasedStateSpacePtr& getStateSpace() const
+  {
+    return space_;
+  }
+
+  /// \brief Append \e state to the storage
+  void addState(const ompl::base::State *state);
+
+  /// \brief Decompress state \e index into \e state, which must be allocated by the state space.
+  /// The known information of \e state (validity, distance, cost) is cleared.
+  void getState(std::size_t index, ompl::base::State *state) const;
+
+  std::size_t size() const
+  {
+    return tags_.size();
+  }
+
+  void reserve(std::size_t count);
+  void clear();
+
+  /// \brief The largest difference between a stored value of \e variable and the value that was added,
+  /// for values within the bounds
+  double getMaxError(unsigned int variable) const;
+
+  /// \brief The number of bytes used for the stored states
+  std::size_t getMemoryUsage() const;
+
+protected:
+
+  ModelBasedStateSpacePtr     space_;
+  Precision                   precision_;
+  unsigned int                variable_count_;
+
+  /// \brief Lower bound and quantization step of each variable (UINT16 only)
+  std::vector<double>         lower_;
+  std::vector<double>         step_;
+  /// \brief Whether each variable is an angle wrapped into [-pi, pi] (UINT16 only)
+  std::vector<bool>           wrap_;
+
+  std::vector<boost::int32_t>  tags_;
+  std::vector<float>           float_values_;
+  std::vector<boost::uint16_t> quantized_values_;
+};
+
+}
+
+#endif
@@ -43,6 +43,10 @@
 
 #include <moveit/robot_state/robot_state.h>
 #include <moveit/robot_model/joint_model_group.h>
+#include "moveit/ompl_interface/detail/reachability_map.h"
+#include "moveit/ompl_interface/detail/worker_pool.h"
+#include "moveit/ompl_interface/detail/goal_sample_cache.h"
+#include <boost/atomic.hpp>
 
 namespace ompl_interface
 {
@@ -50,30 +54,171 @@ namespace ompl_interface
 class OMPLPlanningContext;
 
 /** @class ConstrainedGoalSampler
- *  An interface to the OMPL goal lazy sampler*/
+ *  An interface to the OMPL goal lazy sampler.  The goal region can be sampled by several threads; each
+ *  has its own samplers, so their random streams are independent.  The first goal state found by any of
+ *  them is returned to the sampling thread of GoalLazySamples, the others are added directly.
+ *  With a GoalSampleCache, the goal states of earlier requests for the same goal that are still valid
+ *  are added before sampling starts.*/
 class ConstrainedGoalSampler : public ompl::base::GoalLazySamples
 {
 public:
 
+  /** @brief Constructor.  Sampling does not start until startSampling() is called, or the region is given
+   *  to a GoalSamplingPool.
+   *  @param pc The planning context
+   *  @param ks The goal constraints
+   *  @param cs A constraint sampler for \e ks; if NULL, states are sampled uniformly and tested against \e ks
+   *  @param helper_samplers Constraint samplers for \e ks for additional sampling threads, one per thread.
+   *  Without \e cs, the number of threads is given by OMPLPlanningContext::getGoalSamplingThreads().
+   *  @param cache Goal states of earlier requests (optional)
+   *  @param cache_key The key of this goal in \e cache
+   */
   ConstrainedGoalSampler(const OMPLPlanningContext *pc, const kinematic_constraints::KinematicConstraintSetPtr &ks,
-                         const constraint_samplers::ConstraintSamplerPtr &cs = constraint_samplers::ConstraintSamplerPtr());
+                         const constraint_samplers::ConstraintSamplerPtr &cs = constraint_samplers::ConstraintSamplerPtr(),
+                         const std::vector<constraint_samplers::ConstraintSamplerPtr> &helper_samplers =
+                         std::vector<constraint_samplers::ConstraintSamplerPtr>(),
+                         const GoalSampleCachePtr &cache = GoalSampleCachePtr(), GoalSampleCache::Key cache_key = 0);
+
+  virtual ~ConstrainedGoalSampler();
+
+  /// The number of threads sampling the goal region
+  unsigned int getSamplingThreadCount() const
+  {
+    return workers_.size();
+  }
+
+  /// Store the goal states found so far in the cache given to the constructor, if any.  Call when
+  /// sampling is stopped.
+  void storeSamples();
+
+  /// Set the share of time the sampling threads spend sampling, in [0, 1].  At 0, sampling stops.
+  /// Used to give the processors to the goal regions that produce goal states.
+  void setSamplingPriority(double priority);
+
+  double getSamplingPriority() const
+  {
+    return priority_permille_ / 1000.0;
+  }
+
+  /// With \e flag set, the sampling thread of GoalLazySamples is stopped and not used; the goal region is
+  /// sampled by calls to sampleExternally() from threads shared by several goal regions (GoalSamplingPool)
+  void setExternalSampling(bool flag);
+
+  bool isSampledExternally() const
+  {
+    return external_;
+  }
+
+  /// Allow (or stop) calls to sampleExternally().  Stopping makes running calls return promptly.
+  void setExternalSamplingActive(bool flag);
+
+  /// Make one sampling attempt and add the goal state found, if any.  \e scratch is a state owned by the
+  /// calling thread.  Returns false, without sampling, when the goal region should not be sampled anymore:
+  /// its attempts or goal states are exhausted, a solution was found, or the region was given up.
+  /// Not reentrant.
+  bool sampleExternally(ompl::base::State *scratch);
+
+  /// The number of sampling attempts made by all sampling threads
+  unsigned long getAttemptCount() const
+  {
+    return total_attempts_;
+  }
+
+  /// The time spent sampling (not counting the time throttled by the priority), in seconds
+  double getSamplingTime() const
+  {
+    return sampling_time_us_ * 1e-6;
+  }
+
+  /// The number of goal states taken from the goal sample cache rather than produced by sampling
+  unsigned int getCachedStateCount() const
+  {
+    return cached_states_;
+  }
+
+  /// The number of goal states produced by sampling this goal region (i.e., not taken from the cache)
+  std::size_t getSampledStateCount() const
+  {
+    std::size_t count = getStateCount();
+    return count > cached_states_ ? count - cached_states_ : 0;
+  }
 
 private:
 
+  /// The samplers and scratch space of one sampling thread
+  struct Worker
+  {
+    Worker(const robot_state::RobotState &state) : work_state(state), goal(NULL), found(false)
+    {
+    }
+
+    constraint_samplers::ConstraintSamplerPtr constraint_sampler;
+    ompl::base::StateSamplerPtr               default_sampler;
+    robot_state::RobotState                   work_state;
+    ompl::base::State                        *goal;
+    bool                                      found;
+  };
+  typedef std::shared_ptr<Worker> WorkerPtr;
+
   bool sampleUsingConstraintSampler(const ompl::base::GoalLazySamples *gls, ompl::base::State *new_goal);
+
+  /// Run all workers until one finds a goal state; return true if \e new_goal is set to a goal state
+  bool sampleConcurrently(const ompl::base::GoalLazySamples *gls, ompl::base::State *new_goal, unsigned int attempts_so_far);
+
+  /// Sample with worker \e index until any worker finds a goal state or the attempts are exhausted
+  void sampleWorker(const ompl::base::GoalLazySamples *gls, unsigned int index);
+
+  /// True if the goal region should not be sampled anymore
+  bool isExhausted(const ompl::base::GoalLazySamples *gls) const;
+
+  /// Make one sampling attempt with \e worker; return true if \e new_goal is a valid goal state
+  bool sampleOnce(Worker &worker, ompl::base::State *new_goal, unsigned int attempt, bool verbose);
+
+  /// Replace GoalLazySamples::isSampling() and samplingAttemptsCount(), which do not know about external sampling
+  bool isSamplingActive(const ompl::base::GoalLazySamples *gls) const;
+  unsigned int getCallCount(const ompl::base::GoalLazySamples *gls) const;
+
+  /// Wait for \e duration seconds, or until sampling stops or the priority becomes 1
+  void throttle(const ompl::base::GoalLazySamples *gls, double duration) const;
+
+  /// Return true if \e attempt should report why it fails (once, late in the attempts without a goal state)
+  bool isVerboseAttempt(const ompl::base::GoalLazySamples *gls, unsigned int attempt, unsigned int max_attempts);
+
   bool stateValidityCallback(ompl::base::State* new_goal, robot_state::RobotState const* state,
                               const robot_model::JointModelGroup*, const double*, bool verbose=false) const;
   bool checkStateValidity(ompl::base::State* new_goal, const robot_state::RobotState& state, bool verbose=false) const;
 
+  /// Add the cached states that satisfy the constraints and are valid in the current scene
+  void addCachedSamples();
+
+  /// Return false if the position constraints on the tip of \e map lie entirely in regions the tip never reached.
+  /// \e inside is set to false if they lie entirely outside the grid of the map, i.e., far from any reached position.
+  bool isGoalRegionReachable(const ReachabilityMap &map, bool &inside);
+
   const OMPLPlanningContext                       *planning_context_;
   kinematic_constraints::KinematicConstraintSetPtr kinematic_constraint_set_;
-  constraint_samplers::ConstraintSamplerPtr        constraint_sampler_;
-  ompl::base::StateSamplerPtr                      default_sampler_;
-  robot_state::RobotState                          work_state_;
-  unsigned int                                     invalid_sampled_constraints_;
-  bool                                             warned_invalid_samples_;
+  GoalSampleCachePtr                               cache_;
+  GoalSampleCache::Key                             cache_key_;
+  std::vector<WorkerPtr>                           workers_;
+  /// Runs the workers other than the first one; created by the first concurrent sampling call
+  std::shared_ptr<WorkerPool>                      pool_;
+  boost::atomic<unsigned int>                      attempts_;
+  boost::atomic<bool>                              found_;
+  boost::atomic<unsigned int>                      invalid_sampled_constraints_;
+  boost::atomic<bool>                              warned_invalid_samples_;
   unsigned int                                     verbose_display_;
-};
-}
+  boost::atomic<unsigned int>                      priority_permille_;
+  boost::atomic<unsigned long>                     total_attempts_;
+  boost::atomic<unsigned long>                     sampling_time_us_;
+  /// Duration of the last call to sampleUsingConstraintSampler(), in seconds
+  double                                           last_call_time_;
+  bool                                             external_;
+  boost::atomic<bool>                              external_active_;
+  unsigned int                                     external_calls_;
+  /// The number of goal states added by addCachedSamples()
+  unsigned int                                     cached_states_;
+  /// False if the goal region is outside the reachability map, so it cannot be reached; no IK is attempted then
+  bool                                             reachable_;
+};}
 
 #endif
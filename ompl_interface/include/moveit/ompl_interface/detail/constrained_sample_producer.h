@@ -0,0 +1,155 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_CONSTRAINED_SAMPLE_PRODUCER_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_CONSTRAINED_SAMPLE_PRODUCER_
+
+#include "moveit/ompl_interface/detail/mpmc_ring.h"
+#include "moveit/ompl_interface/parameterization/model_based_state_space.h"
+#include <moveit/constraint_samplers/constraint_sampler.h>
+#include <ompl/base/State.h>
+#include <ompl/util/Time.h>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+
+namespace ompl_interface
+{
+
+class OMPLPlanningContext;
+
+/** @class ConstrainedSampleProducer
+    @brief Background threads that draw states satisfying the path constraints and hand them to the
+    samplers of the planner through a lock-free ring.  Every thread uses its own constraint sampler.
+    The states circulate between two rings: the free ring holds the states threads can fill, the
+    ready ring those that hold a sample.  The states are allocated by the first start(), and nothing
+    is allocated after that until releaseStates().
+    A consumer that finds the ready ring empty is expected to sample inline. */
+class ConstrainedSampleProducer : private boost::noncopyable
+{
+public:
+
+  typedef boost::function<constraint_samplers::ConstraintSamplerPtr()> ConstraintSamplerAllocator;
+
+  /** @brief Constructor
+   *  @param pc The planning context whose state space the samples belong to
+   *  @param csa Allocates a constraint sampler for the path constraints; called once per thread
+   *  @param thread_count The number of producing threads
+   *  @param capacity The number of samples that can be buffered
+   */
+  ConstrainedSampleProducer(const OMPLPlanningContext *pc, const ConstraintSamplerAllocator &csa,
+                            unsigned int thread_count, std::size_t capacity);
+  ~ConstrainedSampleProducer();
+
+  /// \brief Start the threads; does nothing if they are running
+  void start();
+
+  /// \brief Stop the threads and wait for them.  The samples that are buffered are kept for the next start().
+  void stop();
+
+  /// \brief Stop the threads and free the buffered states; the next start() allocates them again
+  void releaseStates();
+
+  bool isRunning() const
+  {
+    return running_;
+  }
+
+  /// \brief Copy a buffered sample into \e state.  Returns false if no sample is buffered.  Thread safe.
+  bool consume(ompl::base::State *state);
+
+  unsigned int getThreadCount() const
+  {
+    return thread_count_;
+  }
+
+  /// \brief The number of samples that were produced since the last resetCounters()
+  unsigned long getProducedCount() const
+  {
+    return produced_;
+  }
+
+  /// \brief The number of samples that were consumed since the last resetCounters()
+  unsigned long getConsumedCount() const
+  {
+    return consumed_;
+  }
+
+  /// \brief The number of times consume() found the buffer empty since the last resetCounters()
+  unsigned long getMissCount() const
+  {
+    return misses_;
+  }
+
+  /// \brief The number of draws of the constraint samplers of the threads that did not produce a sample
+  unsigned long getFailedDrawCount() const
+  {
+    return failed_draws_;
+  }
+
+  /// \brief The time the threads ran since the last resetCounters(), in seconds
+  double getRunTime() const;
+
+  void resetCounters();
+
+private:
+
+  void producer();
+
+  const OMPLPlanningContext               *planning_context_;
+  ModelBasedStateSpacePtr                 space_;
+  ConstraintSamplerAllocator              allocator_;
+  unsigned int                            thread_count_;
+
+  std::size_t                             capacity_;
+  std::vector<ompl::base::State*>         states_;
+  MPMCRing<ompl::base::State*>            free_;
+  MPMCRing<ompl::base::State*>            ready_;
+
+  boost::thread_group                     threads_;
+  boost::atomic<bool>                     stop_;
+  bool                                    running_;
+  ompl::time::point                       start_time_;
+  double                                  run_time_;
+
+  boost::atomic<unsigned long>            produced_;
+  boost::atomic<unsigned long>            consumed_;
+  boost::atomic<unsigned long>            misses_;
+  boost::atomic<unsigned long>            failed_draws_;
+};
+
+typedef std::shared_ptr<ConstrainedSampleProducer> ConstrainedSampleProducerPtr;
+
+}
+
+#endif
@@ -40,20 +40,37 @@
 #include <ompl/base/StateSampler.h>
 #include <moveit/constraint_samplers/constraint_sampler.h>
 #include "moveit/ompl_interface/ompl_planning_context.h"
+#include "moveit/ompl_interface/detail/constrained_sample_producer.h"
 
 namespace ompl_interface
 {
 
 /** @class ConstrainedSampler
- *  This class defines a sampler that tries to find a sample that satisfies the constraints*/
+ *  This class defines a sampler that tries to find a sample that satisfies the constraints.
+ *  Each draw uses one of several strategies, chosen at random from a mix that is adapted online:
+ *  strategies that produce samples satisfying the constraints in less time are drawn more often.
+ *  Every strategy keeps a small share of the draws, so the estimates can recover.
+ *  If a ConstrainedSampleProducer is given, the constraint sampler strategy takes the samples it buffered
+ *  and only samples inline when the buffer is empty.*/
 class ConstrainedSampler : public ompl::base::StateSampler
 {
 public:
+
+  enum Strategy
+  {
+    CONSTRAINT_SAMPLER = 0, // ConstraintSampler::sample()
+    REJECTION,              // default sampling, kept if the path constraints are satisfied
+    PROJECTION,             // default sampling, projected with ConstraintSampler::project()
+    STRATEGY_COUNT
+  };
+
   /** @brief Default constructor
    *  @param pg The planning group
    *  @param cs A pointer to a kinematic constraint sampler
+   *  @param producer Background threads sampling the same constraints (optional)
    */
-  ConstrainedSampler(const OMPLPlanningContext *pc, const constraint_samplers::ConstraintSamplerPtr &cs);
+  ConstrainedSampler(const OMPLPlanningContext *pc, const constraint_samplers::ConstraintSamplerPtr &cs,
+                     const ConstrainedSampleProducerPtr &producer = ConstrainedSampleProducerPtr());
 
   /** @brief Sample a state (uniformly)*/
   virtual void sampleUniform(ompl::base::State *state);
@@ -64,19 +81,52 @@ public:
   /** @brief Sample a state using the specified Gaussian*/
   virtual void sampleGaussian(ompl::base::State *state, const ompl::base::State *mean, const double stdDev);
 
+  virtual ~ConstrainedSampler();
+
   double getConstrainedSamplingRate() const;
 
+  /** @brief The current probability of drawing each strategy; unavailable strategies have probability 0*/
+  void getSamplingMix(double mix[STRATEGY_COUNT]) const;
+
+  /** @brief The fraction of draws of \e strategy that produced a sample, with decay of old draws*/
+  double getSuccessRate(Strategy strategy) const;
+
 private:
 
+  struct StrategyStatistics
+  {
+    StrategyStatistics() : attempts(0.0), successes(0.0), time(0.0)
+    {
+    }
+
+    double attempts;
+    double successes;
+    double time;
+  };
+
   bool sampleC(ompl::base::State *state);
+  bool sampleRejection(ompl::base::State *state);
+  bool sampleProjection(ompl::base::State *state);
+
+  /** @brief Draw a strategy from the mix and try it once; return true if \e state satisfies the constraints*/
+  bool sampleAdaptive(ompl::base::State *state);
+
+  /** @brief Recompute the mix from the success rates and times of the strategies*/
+  void updateMix();
 
   const OMPLPlanningContext                         *planning_context_;
   ompl::base::StateSamplerPtr                       default_;
   constraint_samplers::ConstraintSamplerPtr         constraint_sampler_;
+  ConstrainedSampleProducerPtr                      producer_;
   robot_state::RobotState                           work_state_;
   unsigned int                                      constrained_success_;
   unsigned int                                      constrained_failure_;
   double                                            inv_dim_;
+
+  bool                                              available_[STRATEGY_COUNT];
+  StrategyStatistics                                statistics_[STRATEGY_COUNT];
+  double                                            mix_[STRATEGY_COUNT];
+  unsigned int                                      draws_since_update_;
 };
 
 }
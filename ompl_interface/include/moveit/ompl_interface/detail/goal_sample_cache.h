@@ -0,0 +1,113 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_GOAL_SAMPLE_CACHE_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_GOAL_SAMPLE_CACHE_
+
+#include <moveit_msgs/Constraints.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <memory>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ompl_interface
+{
+
+/** @class GoalSampleCache
+    @brief Valid goal configurations from earlier requests, by goal.  Requests that repeat a goal (e.g.,
+    picking at a fixed station) start with these states instead of solving IK again.  A goal is
+    identified by a hash of its constraints and the group, so a lookup may return the states of another
+    goal; users check the states against the constraints and the current scene before using them.
+    The least recently used goals are evicted first.  Thread safe. */
+class GoalSampleCache : private boost::noncopyable
+{
+public:
+
+  typedef std::size_t Key;
+  typedef std::vector<double> Sample;
+
+  /// \brief Keep the samples of at most \e max_goals goals, and at most \e max_samples_per_goal samples per goal
+  GoalSampleCache(std::size_t max_goals = 256, std::size_t max_samples_per_goal = 50);
+
+  /// \brief The key of \e goal (the goal constraints merged with the path constraints) for \e group.
+  /// Header stamps are ignored, so the same goal requested again has the same key.
+  static Key computeKey(const std::string &group, const moveit_msgs::Constraints &goal);
+
+  /// \brief Remember \e samples (joint group positions) for \e key.  They come first; samples stored
+  /// before are kept after them, up to the per-goal limit.
+  void store(Key key, const std::vector<Sample> &samples);
+
+  /// \brief Get the samples stored for \e key.  Returns false if there are none.
+  bool retrieve(Key key, std::vector<Sample> &samples);
+
+  void clear();
+
+  std::size_t getGoalCount() const;
+
+  /// \brief The number of samples stored over all goals
+  std::size_t getSampleCount() const;
+
+  /// \brief The number of bytes held by the stored goals and samples
+  std::size_t getMemoryUsage() const;
+
+  /// \brief The number of calls to retrieve() that found samples
+  unsigned long getHitCount() const;
+
+  /// \brief The number of calls to retrieve() that did not find samples
+  unsigned long getMissCount() const;
+
+private:
+
+  struct Entry
+  {
+    std::vector<Sample> samples;
+    unsigned long       last_use;
+  };
+
+  mutable boost::mutex  lock_;
+  std::map<Key, Entry>  entries_;
+  std::size_t           max_goals_;
+  std::size_t           max_samples_per_goal_;
+  unsigned long         use_counter_;
+  unsigned long         hits_;
+  unsigned long         misses_;
+};
+
+typedef std::shared_ptr<GoalSampleCache> GoalSampleCachePtr;
+
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_GOAL_SAMPLING_POOL_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_GOAL_SAMPLING_POOL_
+
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+#include <memory>
+#include <vector>
+
+namespace ompl_interface
+{
+
+class ConstrainedGoalSampler;
+
+/** @class GoalSamplingPool
+    @brief A bounded set of threads that sample many goal regions, instead of a thread per region.
+    Each thread repeatedly takes the region that is not being sampled and has received the least
+    sampling time relative to its priority (stride scheduling), and makes one sampling attempt for it.
+    Regions thus share the processors in proportion to their sampling priority.  A region is dropped
+    once its attempts or goal states are exhausted, a solution is found, or it is given up. */
+class GoalSamplingPool : private boost::noncopyable
+{
+public:
+
+  /// \brief The regions must outlive the pool, and are switched to external sampling
+  GoalSamplingPool(const std::vector<ConstrainedGoalSampler*> &regions, unsigned int thread_count);
+  ~GoalSamplingPool();
+
+  /// \brief Start sampling all regions; does nothing if the pool is running
+  void start();
+
+  /// \brief Stop sampling and wait for the threads
+  void stop();
+
+  /// \brief True while the threads run and some region can still produce goal states
+  bool isSampling() const;
+
+  unsigned int getThreadCount() const
+  {
+    return thread_count_;
+  }
+
+private:
+
+  struct Region
+  {
+    ConstrainedGoalSampler *sampler;
+    /// Sampling time received, divided by the priority
+    double                  pass;
+    bool                    busy;
+    bool                    done;
+  };
+
+  void worker();
+
+  /// \brief The region to sample next, or -1 if all the regions left are busy.  The lock must be held.
+  int claim() const;
+
+  std::vector<Region>       regions_;
+  unsigned int              thread_count_;
+  boost::thread_group       threads_;
+  mutable boost::mutex      lock_;
+  boost::condition_variable released_;
+  /// Number of regions that are not done
+  unsigned int              active_;
+  bool                      running_;
+  bool                      stop_;
+};
+
+typedef std::shared_ptr<GoalSamplingPool> GoalSamplingPoolPtr;
+
+}
+
+#endif
@@ -38,22 +38,37 @@
 #define MOVEIT_OMPL_INTERFACE_GOALMUX_
 
 #include <ompl/base/goals/GoalSampleableRegion.h>
+#include <ompl/datastructures/NearestNeighbors.h>
+#include <ompl/util/Time.h>
+#include <boost/thread/mutex.hpp>
+#include "moveit/ompl_interface/detail/goal_sampling_pool.h"
 
 namespace ompl_interface
 {
 
-/** @class GoalSampleableRegionMux*/
+class ConstrainedGoalSampler;
+
+/** @class GoalSampleableRegionMux
+ *  A union of goal regions.  Goal samples are drawn from the regions that have states in turn.  The
+ *  sampling threads of the regions are scheduled by their yield (goal states per second of sampling):
+ *  regions that produce less get a smaller share of the processors, and regions that produce nothing
+ *  while others do are given up.
+ *  The goal states of the regions that are ConstrainedGoalSampler instances are also kept in a single
+ *  nearest neighbors structure, so isSatisfied() and distanceGoal() do not iterate over all regions
+ *  and their states.  If the structure is constructed in a JointSpaceMetric::Scope, it is a
+ *  NearestNeighborsJointSpace.  With many regions, a GoalSamplingPool with a bounded number of threads
+ *  samples them instead of a thread per region.*/
 class GoalSampleableRegionMux : public ompl::base::GoalSampleableRegion
 {
 public:
 
   /** @brief Constructor
-   *  @param goals The input set of goals*/
-  GoalSampleableRegionMux(const std::vector<ompl::base::GoalPtr> &goals);
+   *  @param goals The input set of goals
+   *  @param pool_threads If not 0, the goals that are ConstrainedGoalSampler instances are sampled
+   *  by a GoalSamplingPool with this number of threads*/
+  GoalSampleableRegionMux(const std::vector<ompl::base::GoalPtr> &goals, unsigned int pool_threads = 0);
 
-  virtual ~GoalSampleableRegionMux()
-  {
-  }
+  virtual ~GoalSampleableRegionMux();
 
   /** @brief Sample a goal*/
   virtual void sampleGoal(ompl::base::State *st) const;
@@ -73,19 +88,62 @@ public:
   /** @brief Find the distance of this state from the goal*/
   virtual double distanceGoal(const ompl::base::State *st) const;
 
+  /** @brief The member goals */
+  const std::vector<ompl::base::GoalPtr>& getGoals() const
+  {
+    return goals_;
+  }
+
+  /** @brief Number of states stored by the member goals that keep a set of states */
+  std::size_t getStateCount() const;
+
   /** @brief If there are any member lazy samplers, start them */
   void startSampling();
 
   /** @brief If there are any member lazy samplers, stop them */
   void stopSampling();
 
+  /** @brief The number of goal regions that were given up during the last solve */
+  unsigned int getAbandonedGoalCount() const;
+
   /** @brief Pretty print goal information*/
   virtual void print(std::ostream &out = std::cout) const;
 
 protected:
 
+  /** @brief A goal state of a member region, in the nearest neighbors structure */
+  struct GoalState
+  {
+    ompl::base::State *state;
+    unsigned int       goal;
+  };
+
+  /** @brief Add a copy of \e st, a new state of goal \e goal, to the nearest neighbors structure */
+  void addGoalState(unsigned int goal, const ompl::base::State *st);
+
+  /** @brief The distance from \e st to the closest goal state in the nearest neighbors structure
+   *  (infinity if there is none); \e goal is set to the region of that state */
+  double nearestGoalState(const ompl::base::State *st, unsigned int &goal) const;
+
+  double distanceGoalStates(const GoalState* const &a, const GoalState* const &b) const;
+
+  /** @brief Recompute the sampling priorities of the goal regions, at most once per scheduling period */
+  void updateSchedule() const;
+
   std::vector<ompl::base::GoalPtr> goals_;
   mutable unsigned int             gindex_;
+
+  /// The goals that are ConstrainedGoalSampler instances; NULL for others
+  std::vector<ConstrainedGoalSampler*> samplers_;
+  mutable boost::mutex               schedule_lock_;
+  mutable ompl::time::point          last_schedule_;
+
+  std::shared_ptr<ompl::NearestNeighbors<GoalState*> > goal_states_;
+  std::vector<GoalState*>                              goal_state_storage_;
+  mutable boost::mutex                                 goal_states_lock_;
+
+  /// Declared last, so its threads are stopped before the other members are destroyed
+  GoalSamplingPoolPtr                                  pool_;
 };
 
 }
@@ -0,0 +1,121 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_JOINT_PATH_CONSTRAINT_TABLE_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_JOINT_PATH_CONSTRAINT_TABLE_
+
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/macros/class_forward.h>
+#include <moveit_msgs/Constraints.h>
+#include <vector>
+#include <cmath>
+
+namespace ompl_interface
+{
+
+MOVEIT_CLASS_FORWARD(JointPathConstraintTable);
+
+/** @class JointPathConstraintTable
+    @brief Path constraints that consist only of joint constraints on single-variable, bounded
+    joints of a group, compiled into a flat table of intervals over the group's variables.
+    The table is evaluated directly on the joint values of a state, so no RobotState needs
+    to be computed to decide the path constraints.  The result is the same as that of
+    kinematic_constraints::KinematicConstraintSet::decide() for the same constraints. */
+class JointPathConstraintTable
+{
+public:
+
+  /// \brief Compile \e constraints for the variables of \e jmg.  Use isValid() to find out
+  /// whether the constraints could be compiled.
+  JointPathConstraintTable(const robot_model::RobotModelConstPtr &robot_model, const robot_model::JointModelGroup *jmg,
+                           const moveit_msgs::Constraints &constraints);
+
+  /// \brief True if all the constraints were compiled into the table.  If false, the
+  /// constraints must be evaluated on a RobotState.
+  bool isValid() const
+  {
+    return valid_;
+  }
+
+  /// \brief Decide whether the group variable values \e values satisfy the constraints.  If
+  /// \e distance is not NULL, it is set to the sum of the distances to each constraint, weighted
+  /// by the constraint weights.
+  bool decide(const double *values, double *distance = NULL) const
+  {
+    bool satisfied = true;
+    double d = 0.0;
+    for (std::size_t i = 0 ; i < entries_.size() ; ++i)
+    {
+      const Entry &e = entries_[i];
+      double dif = values[e.index] - e.position;
+      if (dif > e.above || dif < e.below)
+        satisfied = false;
+      d += e.weight * fabs(dif);
+    }
+    if (distance)
+      *distance = d;
+    return satisfied;
+  }
+
+  /// \brief Restrict \e bounds (one entry per active joint of the group, in order) to the
+  /// intervals of the table.  Intervals that do not intersect the joint bounds are ignored.
+  /// Narrower bounds reduce the maximum extent of a state space built on them, and with it the
+  /// length of the longest valid segment; users of the bounds must compensate for this.
+  void restrictBounds(std::vector<robot_model::JointModel::Bounds> &bounds) const;
+
+protected:
+
+  struct Entry
+  {
+    /// \brief The index of the variable within the group
+    unsigned int index;
+    /// \brief The index of the joint within the active joints of the group
+    unsigned int joint;
+    double       position;
+    /// \brief Largest allowed positive deviation from position (including tolerance)
+    double       above;
+    /// \brief Largest allowed negative deviation from position (negative, including tolerance)
+    double       below;
+    /// \brief The weight of the constraint in the distance
+    double       weight;
+  };
+
+  const robot_model::JointModelGroup *jmg_;
+  std::vector<Entry>                  entries_;
+  bool                                valid_;
+};
+
+}
+
+#endif
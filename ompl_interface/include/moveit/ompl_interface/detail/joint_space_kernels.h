@@ -0,0 +1,174 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_JOINT_SPACE_KERNELS_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_JOINT_SPACE_KERNELS_
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ompl_interface
+{
+
+/// \brief Loops over arrays of joint values, for groups made of bounded single-variable joints.
+/// They use AVX or SSE2 when the compiler targets them, and plain loops otherwise.
+namespace kernels
+{
+
+#if defined(__AVX__)
+inline double horizontalSum(__m256d v)
+{
+  __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+#endif
+
+/// \brief Sum of |a[i] - b[i]| * w[i]
+inline double weightedDistance(const double *a, const double *b, const double *w, unsigned int n)
+{
+  double d = 0.0;
+  unsigned int i = 0;
+#if defined(__AVX__)
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  __m256d acc = _mm256_setzero_pd();
+  for ( ; i + 4 <= n ; i += 4)
+  {
+    __m256d diff = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    acc = _mm256_add_pd(acc, _mm256_mul_pd(diff, _mm256_loadu_pd(w + i)));
+  }
+  d = horizontalSum(acc);
+#elif defined(__SSE2__)
+  const __m128d sign = _mm_set1_pd(-0.0);
+  __m128d acc = _mm_setzero_pd();
+  for ( ; i + 2 <= n ; i += 2)
+  {
+    __m128d diff = _mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    acc = _mm_add_pd(acc, _mm_mul_pd(diff, _mm_loadu_pd(w + i)));
+  }
+  d = _mm_cvtsd_f64(_mm_add_sd(acc, _mm_unpackhi_pd(acc, acc)));
+#endif
+  for ( ; i < n ; ++i)
+    d += fabs(a[i] - b[i]) * w[i];
+  return d;
+}
+
+/// \brief out[i] = from[i] + (to[i] - from[i]) * t
+inline void interpolate(const double *from, const double *to, double t, double *out, unsigned int n)
+{
+  unsigned int i = 0;
+#if defined(__AVX__)
+  const __m256d vt = _mm256_set1_pd(t);
+  for ( ; i + 4 <= n ; i += 4)
+  {
+    __m256d f = _mm256_loadu_pd(from + i);
+    _mm256_storeu_pd(out + i, _mm256_add_pd(f, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(to + i), f), vt)));
+  }
+#elif defined(__SSE2__)
+  const __m128d vt = _mm_set1_pd(t);
+  for ( ; i + 2 <= n ; i += 2)
+  {
+    __m128d f = _mm_loadu_pd(from + i);
+    _mm_storeu_pd(out + i, _mm_add_pd(f, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(to + i), f), vt)));
+  }
+#endif
+  for ( ; i < n ; ++i)
+    out[i] = from[i] + (to[i] - from[i]) * t;
+}
+
+/// \brief True if lower[i] <= v[i] <= upper[i] for all i
+inline bool withinBounds(const double *v, const double *lower, const double *upper, unsigned int n)
+{
+  unsigned int i = 0;
+#if defined(__AVX__)
+  for ( ; i + 4 <= n ; i += 4)
+  {
+    __m256d x = _mm256_loadu_pd(v + i);
+    __m256d ok = _mm256_and_pd(_mm256_cmp_pd(x, _mm256_loadu_pd(lower + i), _CMP_GE_OQ),
+                               _mm256_cmp_pd(x, _mm256_loadu_pd(upper + i), _CMP_LE_OQ));
+    if (_mm256_movemask_pd(ok) != 0xF)
+      return false;
+  }
+#elif defined(__SSE2__)
+  for ( ; i + 2 <= n ; i += 2)
+  {
+    __m128d x = _mm_loadu_pd(v + i);
+    __m128d ok = _mm_and_pd(_mm_cmpge_pd(x, _mm_loadu_pd(lower + i)), _mm_cmple_pd(x, _mm_loadu_pd(upper + i)));
+    if (_mm_movemask_pd(ok) != 0x3)
+      return false;
+  }
+#endif
+  for ( ; i < n ; ++i)
+    if (!(v[i] >= lower[i] && v[i] <= upper[i]))
+      return false;
+  return true;
+}
+
+/// \brief True if |a[i] - b[i]| <= eps for all i
+inline bool equal(const double *a, const double *b, double eps, unsigned int n)
+{
+  unsigned int i = 0;
+#if defined(__AVX__)
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  const __m256d veps = _mm256_set1_pd(eps);
+  for ( ; i + 4 <= n ; i += 4)
+  {
+    __m256d diff = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    if (_mm256_movemask_pd(_mm256_cmp_pd(diff, veps, _CMP_GT_OQ)))
+      return false;
+  }
+#elif defined(__SSE2__)
+  const __m128d sign = _mm_set1_pd(-0.0);
+  const __m128d veps = _mm_set1_pd(eps);
+  for ( ; i + 2 <= n ; i += 2)
+  {
+    __m128d diff = _mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    if (_mm_movemask_pd(_mm_cmpgt_pd(diff, veps)))
+      return false;
+  }
+#endif
+  for ( ; i < n ; ++i)
+    if (fabs(a[i] - b[i]) > eps)
+      return false;
+  return true;
+}
+
+}
+}
+
+#endif
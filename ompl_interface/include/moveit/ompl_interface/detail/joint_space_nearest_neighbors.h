@@ -0,0 +1,577 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_JOINT_SPACE_NEAREST_NEIGHBORS_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_JOINT_SPACE_NEAREST_NEIGHBORS_
+
+#include "moveit/ompl_interface/parameterization/model_based_state_space.h"
+#include <ompl/datastructures/NearestNeighbors.h>
+#include <ompl/util/Exception.h>
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <cmath>
+
+namespace ompl_interface
+{
+
+/// \brief The metric of JointModelGroup::distance() for groups whose active joints all have a single
+/// variable: the sum of the absolute differences of the joint values, weighted by the distance factor
+/// of each joint.  Differences of continuous joints wrap around.
+struct JointSpaceMetric
+{
+  /// \brief The largest number of dimensions supported
+  static const unsigned int MAX_DIMENSION = 64;
+
+  /// \brief Configure the metric for \e jmg.  Returns false if the group has joints other than revolute
+  /// and prismatic ones, or too many joints.
+  bool configure(const robot_model::JointModelGroup *jmg);
+
+  unsigned int getDimension() const
+  {
+    return index.size();
+  }
+
+  /// \brief The value of dimension \e d of \e values, normalized to [-pi, pi] for continuous joints
+  double getCoordinate(const double *values, unsigned int d) const
+  {
+    double v = values[index[d]];
+    if (wrap[d])
+    {
+      const double pi = boost::math::constants::pi<double>();
+      v = fmod(v, 2.0 * pi);
+      if (v < -pi)
+        v += 2.0 * pi;
+      else if (v > pi)
+        v -= 2.0 * pi;
+    }
+    return v;
+  }
+
+  /// \brief Sets the metric used by the NearestNeighborsJointSpace instances constructed by this
+  /// thread while the scope exists.  Needed because OMPL planners construct their nearest
+  /// neighbors structures without arguments.
+  class Scope
+  {
+  public:
+    Scope(const JointSpaceMetric *metric);
+    ~Scope();
+
+  private:
+    const JointSpaceMetric *previous_;
+  };
+
+  /// \brief The metric of the innermost Scope of this thread (NULL if none)
+  static const JointSpaceMetric* getCurrent();
+
+  /// \brief Index of each dimension in the values of the group
+  std::vector<unsigned int> index;
+  /// \brief Distance factor of each dimension
+  std::vector<double>       weight;
+  /// \brief True for dimensions of continuous joints
+  std::vector<char>         wrap;
+};
+
+typedef std::shared_ptr<JointSpaceMetric> JointSpaceMetricPtr;
+
+/** @class NearestNeighborsJointSpace
+    @brief A nearest neighbors structure for states of a ModelBasedStateSpace compared with a
+    JointSpaceMetric, which must be the metric of the space.  Elements are pointers to objects with
+    a \e state member, as the motions of OMPL's tree planners are.  The data is a kd-tree whose
+    leaves keep the coordinates of their elements in a structure-of-arrays layout, so distances
+    to all the elements of a leaf are computed in one pass over contiguous memory.  Subtrees are
+    pruned using the bounding box of each node, which is a lower bound for the metric also with
+    wrap-around.  The distance function given by the planner is not used. */
+template<typename _T>
+class NearestNeighborsJointSpace : public ompl::NearestNeighbors<_T>
+{
+public:
+
+  NearestNeighborsJointSpace()
+    : size_(0)
+  {
+    const JointSpaceMetric *metric = JointSpaceMetric::getCurrent();
+    if (!metric)
+      throw std::runtime_error("NearestNeighborsJointSpace constructed without a JointSpaceMetric");
+    metric_ = *metric;
+    dim_ = metric_.getDimension();
+  }
+
+  virtual ~NearestNeighborsJointSpace()
+  {
+  }
+
+  virtual bool reportsSortedResults() const
+  {
+    return true;
+  }
+
+  virtual void clear()
+  {
+    nodes_.clear();
+    leaves_.clear();
+    boxes_.clear();
+    size_ = 0;
+  }
+
+  virtual std::size_t size() const
+  {
+    return size_;
+  }
+
+  virtual void add(const _T &data)
+  {
+    double q[JointSpaceMetric::MAX_DIMENSION];
+    getCoordinates(data, q);
+
+    if (nodes_.empty())
+    {
+      nodes_.push_back(Node());
+      nodes_.back().leaf = allocLeaf();
+      boxes_.insert(boxes_.end(), q, q + dim_);
+      boxes_.insert(boxes_.end(), q, q + dim_);
+    }
+
+    std::size_t n = 0;
+    while (true)
+    {
+      // grow the bounding box of every node on the way down
+      double *lo = &boxes_[n * 2 * dim_];
+      double *hi = lo + dim_;
+      for (unsigned int d = 0 ; d < dim_ ; ++d)
+      {
+        lo[d] = std::min(lo[d], q[d]);
+        hi[d] = std::max(hi[d], q[d]);
+      }
+      if (nodes_[n].leaf >= 0)
+        break;
+      n = nodes_[n].child[q[nodes_[n].dim] < nodes_[n].split ? 0 : 1];
+    }
+
+    Leaf &leaf = leaves_[nodes_[n].leaf];
+    if (leaf.data.size() == leaf.capacity)
+      growLeaf(leaf, leaf.capacity * 2);
+    std::size_t i = leaf.data.size();
+    for (unsigned int d = 0 ; d < dim_ ; ++d)
+      leaf.coords[d * leaf.capacity + i] = q[d];
+    leaf.data.push_back(data);
+    ++size_;
+
+    if (leaf.data.size() > BUCKET_SIZE)
+      splitLeaf(n);
+  }
+
+  virtual bool remove(const _T &data)
+  {
+    if (nodes_.empty())
+      return false;
+    double q[JointSpaceMetric::MAX_DIMENSION];
+    getCoordinates(data, q);
+
+    std::size_t n = 0;
+    while (nodes_[n].leaf < 0)
+      n = nodes_[n].child[q[nodes_[n].dim] < nodes_[n].split ? 0 : 1];
+
+    // bounding boxes are not shrunk; they remain valid lower bounds
+    Leaf &leaf = leaves_[nodes_[n].leaf];
+    for (std::size_t i = 0 ; i < leaf.data.size() ; ++i)
+      if (leaf.data[i] == data)
+      {
+        std::size_t last = leaf.data.size() - 1;
+        leaf.data[i] = leaf.data[last];
+        for (unsigned int d = 0 ; d < dim_ ; ++d)
+          leaf.coords[d * leaf.capacity + i] = leaf.coords[d * leaf.capacity + last];
+        leaf.data.pop_back();
+        --size_;
+        return true;
+      }
+    return false;
+  }
+
+  virtual _T nearest(const _T &data) const
+  {
+    std::vector<_T> nbh;
+    nearestK(data, 1, nbh);
+    if (nbh.empty())
+      throw ompl::Exception("No elements found in nearest neighbors data structure");
+    return nbh[0];
+  }
+
+  virtual void nearestK(const _T &data, std::size_t k, std::vector<_T> &nbh) const
+  {
+    nbh.clear();
+    if (k == 0 || nodes_.empty())
+      return;
+    double q[JointSpaceMetric::MAX_DIMENSION];
+    getCoordinates(data, q);
+
+    Neighbors heap;
+    heap.reserve(k + 1);
+    searchK(0, q, k, heap);
+
+    std::sort_heap(heap.begin(), heap.end(), NeighborCompare());
+    nbh.reserve(heap.size());
+    for (std::size_t i = 0 ; i < heap.size() ; ++i)
+      nbh.push_back(heap[i].second);
+  }
+
+  virtual void nearestR(const _T &data, double radius, std::vector<_T> &nbh) const
+  {
+    nbh.clear();
+    if (nodes_.empty())
+      return;
+    double q[JointSpaceMetric::MAX_DIMENSION];
+    getCoordinates(data, q);
+
+    Neighbors found;
+    searchR(0, q, radius, found);
+
+    std::sort(found.begin(), found.end(), NeighborCompare());
+    nbh.reserve(found.size());
+    for (std::size_t i = 0 ; i < found.size() ; ++i)
+      nbh.push_back(found[i].second);
+  }
+
+  virtual void list(std::vector<_T> &data) const
+  {
+    data.clear();
+    data.reserve(size_);
+    for (std::size_t i = 0 ; i < leaves_.size() ; ++i)
+      data.insert(data.end(), leaves_[i].data.begin(), leaves_[i].data.end());
+  }
+
+protected:
+
+  /// \brief Leaves are split when they hold more than this many elements
+  static const std::size_t BUCKET_SIZE = 32;
+  struct Node
+  {
+    Node() : dim(0), split(0.0), leaf(-1)
+    {
+      child[0] = child[1] = 0;
+    }
+
+    unsigned int dim;
+    double       split;
+    std::size_t  child[2];
+    /// \brief Index of the leaf data, or -1 for inner nodes
+    int          leaf;
+  };
+
+  struct Leaf
+  {
+    Leaf() : capacity(0)
+    {
+    }
+
+    std::vector<_T>     data;
+    /// \brief Coordinate d of element i is at coords[d * capacity + i]
+    std::vector<double> coords;
+    std::size_t         capacity;
+  };
+
+  typedef std::vector<std::pair<double, _T> > Neighbors;
+
+  struct NeighborCompare
+  {
+    bool operator()(const std::pair<double, _T> &a, const std::pair<double, _T> &b) const
+    {
+      return a.first < b.first;
+    }
+  };
+
+  void getCoordinates(const _T &data, double *q) const
+  {
+    const double *values = data->state->template as<ModelBasedStateSpace::StateType>()->values;
+    for (unsigned int d = 0 ; d < dim_ ; ++d)
+      q[d] = metric_.getCoordinate(values, d);
+  }
+
+  int allocLeaf()
+  {
+    leaves_.push_back(Leaf());
+    growLeaf(leaves_.back(), BUCKET_SIZE + 1);
+    return leaves_.size() - 1;
+  }
+
+  void growLeaf(Leaf &leaf, std::size_t capacity)
+  {
+    std::vector<double> coords(dim_ * capacity);
+    for (unsigned int d = 0 ; d < dim_ ; ++d)
+      for (std::size_t i = 0 ; i < leaf.data.size() ; ++i)
+        coords[d * capacity + i] = leaf.coords[d * leaf.capacity + i];
+    leaf.coords.swap(coords);
+    leaf.capacity = capacity;
+  }
+
+  void splitLeaf(std::size_t n)
+  {
+    // split at the middle of the dimension with the largest weighted spread
+    const int leaf_index = nodes_[n].leaf;
+    unsigned int best_dim = 0;
+    double best_spread = 0.0, best_lo = 0.0, best_hi = 0.0;
+    {
+      const Leaf &leaf = leaves_[leaf_index];
+      for (unsigned int d = 0 ; d < dim_ ; ++d)
+      {
+        const double *c = &leaf.coords[d * leaf.capacity];
+        double lo = c[0], hi = c[0];
+        for (std::size_t i = 1 ; i < leaf.data.size() ; ++i)
+        {
+          lo = std::min(lo, c[i]);
+          hi = std::max(hi, c[i]);
+        }
+        double spread = (hi - lo) * metric_.weight[d];
+        if (spread > best_spread)
+        {
+          best_spread = spread;
+          best_dim = d;
+          best_lo = lo;
+          best_hi = hi;
+        }
+      }
+    }
+    // all elements are at the same location; let the leaf grow
+    if (best_spread <= 0.0)
+      return;
+    double split = 0.5 * (best_lo + best_hi);
+    if (!(split > best_lo))
+      split = best_hi;
+
+    // the left child reuses the leaf of this node
+    Leaf old;
+    std::swap(old, leaves_[leaf_index]);
+    growLeaf(leaves_[leaf_index], BUCKET_SIZE + 1);
+    int right_leaf = allocLeaf();
+
+    std::size_t children[2] = { nodes_.size(), nodes_.size() + 1 };
+    nodes_.resize(nodes_.size() + 2);
+    nodes_[children[0]].leaf = leaf_index;
+    nodes_[children[1]].leaf = right_leaf;
+    nodes_[n].leaf = -1;
+    nodes_[n].dim = best_dim;
+    nodes_[n].split = split;
+    nodes_[n].child[0] = children[0];
+    nodes_[n].child[1] = children[1];
+
+    boxes_.resize(nodes_.size() * 2 * dim_);
+    for (int c = 0 ; c < 2 ; ++c)
+    {
+      double *lo = &boxes_[children[c] * 2 * dim_];
+      std::fill(lo, lo + dim_, std::numeric_limits<double>::infinity());
+      std::fill(lo + dim_, lo + 2 * dim_, -std::numeric_limits<double>::infinity());
+    }
+
+    for (std::size_t i = 0 ; i < old.data.size() ; ++i)
+    {
+      int c = old.coords[best_dim * old.capacity + i] < split ? 0 : 1;
+      Leaf &leaf = leaves_[nodes_[children[c]].leaf];
+      if (leaf.data.size() == leaf.capacity)
+        growLeaf(leaf, leaf.capacity * 2);
+      double *lo = &boxes_[children[c] * 2 * dim_];
+      double *hi = lo + dim_;
+      std::size_t j = leaf.data.size();
+      for (unsigned int d = 0 ; d < dim_ ; ++d)
+      {
+        double v = old.coords[d * old.capacity + i];
+        leaf.coords[d * leaf.capacity + j] = v;
+        lo[d] = std::min(lo[d], v);
+        hi[d] = std::max(hi[d], v);
+      }
+      leaf.data.push_back(old.data[i]);
+    }
+  }
+
+  /// \brief Lower bound of the distance from \e q to any point in the bounding box of node \e n
+  double boxDistance(std::size_t n, const double *q) const
+  {
+    const double pi = boost::math::constants::pi<double>();
+    const double *lo = &boxes_[n * 2 * dim_];
+    const double *hi = lo + dim_;
+    double dist = 0.0;
+    for (unsigned int d = 0 ; d < dim_ ; ++d)
+    {
+      double x = 0.0;
+      if (q[d] < lo[d])
+        x = lo[d] - q[d];
+      else if (q[d] > hi[d])
+        x = q[d] - hi[d];
+      else
+        continue;
+      if (metric_.wrap[d])
+      {
+        // the box may be closer going around the circle
+        double a = fabs(q[d] - lo[d]), b = fabs(q[d] - hi[d]);
+        if (a > pi) a = 2.0 * pi - a;
+        if (b > pi) b = 2.0 * pi - b;
+        x = std::min(a, b);
+      }
+      dist += metric_.weight[d] * x;
+    }
+    return dist;
+  }
+
+  /// \brief Compute the distances from \e q to all the elements of \e leaf
+  void leafDistances(const Leaf &leaf, const double *q, double *dist) const
+  {
+    const double pi = boost::math::constants::pi<double>();
+    const std::size_t count = leaf.data.size();
+    std::fill(dist, dist + count, 0.0);
+    for (unsigned int d = 0 ; d < dim_ ; ++d)
+    {
+      const double *c = &leaf.coords[d * leaf.capacity];
+      const double w = metric_.weight[d];
+      const double qd = q[d];
+      if (metric_.wrap[d])
+        for (std::size_t i = 0 ; i < count ; ++i)
+        {
+          double x = fabs(c[i] - qd);
+          dist[i] += w * (x > pi ? 2.0 * pi - x : x);
+        }
+      else
+        for (std::size_t i = 0 ; i < count ; ++i)
+          dist[i] += w * fabs(c[i] - qd);
+    }
+  }
+
+  template<typename Visitor>
+  void visitLeaf(const Leaf &leaf, const double *q, Visitor &visit) const
+  {
+    if (leaf.data.empty())
+      return;
+    double buffer[2 * BUCKET_SIZE];
+    std::vector<double> large;
+    double *dist = buffer;
+    if (leaf.data.size() > 2 * BUCKET_SIZE)
+    {
+      large.resize(leaf.data.size());
+      dist = &large[0];
+    }
+    leafDistances(leaf, q, dist);
+    for (std::size_t i = 0 ; i < leaf.data.size() ; ++i)
+      visit(dist[i], leaf.data[i]);
+  }
+
+  struct KVisitor
+  {
+    KVisitor(std::size_t k, Neighbors &heap) : k_(k), heap_(heap)
+    {
+    }
+
+    void operator()(double dist, const _T &data)
+    {
+      if (heap_.size() < k_)
+      {
+        heap_.push_back(std::make_pair(dist, data));
+        std::push_heap(heap_.begin(), heap_.end(), NeighborCompare());
+      }
+      else if (dist < heap_.front().first)
+      {
+        std::pop_heap(heap_.begin(), heap_.end(), NeighborCompare());
+        heap_.back() = std::make_pair(dist, data);
+        std::push_heap(heap_.begin(), heap_.end(), NeighborCompare());
+      }
+    }
+
+    std::size_t k_;
+    Neighbors  &heap_;
+  };
+
+  struct RVisitor
+  {
+    RVisitor(double radius, Neighbors &found) : radius_(radius), found_(found)
+    {
+    }
+
+    void operator()(double dist, const _T &data)
+    {
+      if (dist <= radius_)
+        found_.push_back(std::make_pair(dist, data));
+    }
+
+    double     radius_;
+    Neighbors &found_;
+  };
+
+  void searchK(std::size_t n, const double *q, std::size_t k, Neighbors &heap) const
+  {
+    const Node &node = nodes_[n];
+    if (node.leaf >= 0)
+    {
+      KVisitor visit(k, heap);
+      visitLeaf(leaves_[node.leaf], q, visit);
+      return;
+    }
+
+    // visit the closer child first
+    double d0 = boxDistance(node.child[0], q);
+    double d1 = boxDistance(node.child[1], q);
+    std::size_t first = d0 <= d1 ? 0 : 1;
+    double bound[2] = { d0, d1 };
+    for (int i = 0 ; i < 2 ; ++i)
+    {
+      std::size_t c = i == 0 ? first : 1 - first;
+      if (heap.size() < k || bound[c] < heap.front().first)
+        searchK(node.child[c], q, k, heap);
+    }
+  }
+
+  void searchR(std::size_t n, const double *q, double radius, Neighbors &found) const
+  {
+    const Node &node = nodes_[n];
+    if (node.leaf >= 0)
+    {
+      RVisitor visit(radius, found);
+      visitLeaf(leaves_[node.leaf], q, visit);
+      return;
+    }
+    for (int c = 0 ; c < 2 ; ++c)
+      if (boxDistance(node.child[c], q) <= radius)
+        searchR(node.child[c], q, radius, found);
+  }
+
+  JointSpaceMetric    metric_;
+  unsigned int        dim_;
+  std::vector<Node>   nodes_;
+  std::vector<Leaf>   leaves_;
+  /// \brief The bounding box of node n: lower corner at boxes_[2 * n * dim_], upper corner right after
+  std::vector<double> boxes_;
+  std::size_t         size_;
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_MEMORY_USAGE_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_MEMORY_USAGE_
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace ompl_interface
+{
+
+/// \brief Bytes and number of objects held by a component of a planning context, with the
+/// highest values observed.  Sizes of containers are estimates (element size times count, plus
+/// the bucket array for hash maps); allocator overhead is not included.
+struct MemoryUsage
+{
+  MemoryUsage() : bytes(0), objects(0), peak_bytes(0), peak_objects(0)
+  {
+  }
+
+  /// \brief Set the current usage and update the high watermarks
+  void update(std::size_t b, std::size_t o)
+  {
+    bytes = b;
+    objects = o;
+    if (bytes > peak_bytes)
+      peak_bytes = bytes;
+    if (objects > peak_objects)
+      peak_objects = objects;
+  }
+
+  std::size_t bytes;
+  std::size_t objects;
+  std::size_t peak_bytes;
+  std::size_t peak_objects;
+};
+
+/// \brief Memory usage by component name
+typedef std::map<std::string, MemoryUsage> MemoryUsageReport;
+
+inline std::size_t getTotalBytes(const MemoryUsageReport &report)
+{
+  std::size_t total = 0;
+  for (MemoryUsageReport::const_iterator it = report.begin() ; it != report.end() ; ++it)
+    total += it->second.bytes;
+  return total;
+}
+
+inline void printMemoryUsage(const MemoryUsageReport &report, std::ostream &out = std::cout)
+{
+  for (MemoryUsageReport::const_iterator it = report.begin() ; it != report.end() ; ++it)
+    out << "  " << it->first << ": " << it->second.bytes << " bytes in " << it->second.objects
+        << " objects (peak " << it->second.peak_bytes << " bytes, " << it->second.peak_objects << " objects)" << std::endl;
+}
+
+}
+
+#endif
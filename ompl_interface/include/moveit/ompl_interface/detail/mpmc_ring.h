@@ -0,0 +1,145 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_MPMC_RING_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_MPMC_RING_
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <memory>
+
+namespace ompl_interface
+{
+
+/** @class MPMCRing
+    @brief A bounded lock-free queue for any number of producers and consumers (D. Vyukov's design).
+    Every cell carries a sequence number that tells whether it is ready to be written or read in the
+    current lap of the ring, so producers and consumers only contend on their own position counter.
+    The capacity is rounded up to a power of two. */
+template<typename T>
+class MPMCRing : private boost::noncopyable
+{
+public:
+
+  explicit MPMCRing(std::size_t capacity)
+  {
+    std::size_t size = 2;
+    while (size < capacity)
+      size *= 2;
+    mask_ = size - 1;
+    buffer_.reset(new Cell[size]);
+    for (std::size_t i = 0 ; i < size ; ++i)
+      buffer_[i].sequence.store(i, boost::memory_order_relaxed);
+    enqueue_pos_.store(0, boost::memory_order_relaxed);
+    dequeue_pos_.store(0, boost::memory_order_relaxed);
+  }
+
+  std::size_t capacity() const
+  {
+    return mask_ + 1;
+  }
+
+  /// \brief Append \e value; returns false if the ring is full
+  bool push(const T &value)
+  {
+    Cell *cell;
+    std::size_t pos = enqueue_pos_.load(boost::memory_order_relaxed);
+    while (true)
+    {
+      cell = &buffer_[pos & mask_];
+      std::size_t seq = cell->sequence.load(boost::memory_order_acquire);
+      std::ptrdiff_t dif = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+      if (dif == 0)
+      {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+          break;
+      }
+      else if (dif < 0)
+        return false;
+      else
+        pos = enqueue_pos_.load(boost::memory_order_relaxed);
+    }
+    cell->data = value;
+    cell->sequence.store(pos + 1, boost::memory_order_release);
+    return true;
+  }
+
+  /// \brief Remove the oldest value into \e value; returns false if the ring is empty
+  bool pop(T &value)
+  {
+    Cell *cell;
+    std::size_t pos = dequeue_pos_.load(boost::memory_order_relaxed);
+    while (true)
+    {
+      cell = &buffer_[pos & mask_];
+      std::size_t seq = cell->sequence.load(boost::memory_order_acquire);
+      std::ptrdiff_t dif = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+      if (dif == 0)
+      {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+          break;
+      }
+      else if (dif < 0)
+        return false;
+      else
+        pos = dequeue_pos_.load(boost::memory_order_relaxed);
+    }
+    value = cell->data;
+    cell->sequence.store(pos + mask_ + 1, boost::memory_order_release);
+    return true;
+  }
+
+private:
+
+  struct Cell
+  {
+    boost::atomic<std::size_t> sequence;
+    T                          data;
+  };
+
+  static const std::size_t CACHE_LINE = 64;
+
+  std::unique_ptr<Cell[]>    buffer_;
+  std::size_t                mask_;
+  // the positions are written by different threads; keep them on separate cache lines
+  char                       pad0_[CACHE_LINE];
+  boost::atomic<std::size_t> enqueue_pos_;
+  char                       pad1_[CACHE_LINE];
+  boost::atomic<std::size_t> dequeue_pos_;
+  char                       pad2_[CACHE_LINE];
+};
+
+}
+
+#endif
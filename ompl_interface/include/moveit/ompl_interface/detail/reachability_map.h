@@ -0,0 +1,161 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_REACHABILITY_MAP_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_REACHABILITY_MAP_
+
+#include <moveit/robot_model/robot_model.h>
+#include <Eigen/Geometry>
+#include <boost/cstdint.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ompl_interface
+{
+
+/** @class ReachabilityMap
+    @brief A voxel grid over the workspace of the tip link of a group, expressed in the frame of the
+    base of the group (the base frame of its kinematics solver, if it has one).  Every voxel records how
+    many random configurations put the tip in it, which approach directions (the z axis of the tip) were
+    reached there, the mean manipulability of those configurations and, optionally, how often IK
+    succeeded for the reached poses.  The map is built offline (see build_reachability_map.cpp) and
+    loaded from disk; it is used to avoid IK calls for targets that cannot be reached and to prefer
+    well conditioned regions. */
+class ReachabilityMap
+{
+public:
+
+  /// \brief Number of approach direction bins: a cube map with 4 bins per face
+  static const unsigned int ORIENTATION_BINS = 24;
+
+  struct Cell
+  {
+    boost::uint32_t samples;
+    /// \brief Bit i is set if approach direction bin i was reached
+    boost::uint32_t orientations;
+    /// \brief Mean manipulability of the configurations in the cell
+    float           manipulability;
+    boost::uint32_t ik_attempts;
+    boost::uint32_t ik_successes;
+  };
+
+  ReachabilityMap();
+
+  /// \brief Build the map of \e group by sampling \e samples random configurations.  The tip poses of the
+  /// first \e ik_checks samples are also solved with IK from a random seed, to estimate the IK success rate.
+  bool build(const robot_model::RobotModelConstPtr &model, const std::string &group, double resolution,
+             unsigned int samples, unsigned int ik_checks = 0);
+
+  bool save(const std::string &filename) const;
+  bool load(const std::string &filename);
+
+  bool empty() const
+  {
+    return cells_.empty();
+  }
+
+  const std::string& getGroupName() const
+  {
+    return group_;
+  }
+
+  const std::string& getBaseFrame() const
+  {
+    return base_frame_;
+  }
+
+  const std::string& getTipFrame() const
+  {
+    return tip_frame_;
+  }
+
+  double getResolution() const
+  {
+    return resolution_;
+  }
+
+  std::size_t getCellCount() const
+  {
+    return cells_.size();
+  }
+
+  /// \brief The number of bytes held by the cells of the map
+  std::size_t getMemoryUsage() const
+  {
+    return cells_.capacity() * sizeof(Cell);
+  }
+
+  /// \brief The cell containing \e position (in the base frame), or NULL if it is outside the map
+  const Cell* getCell(const Eigen::Vector3d &position) const;
+
+  /// \brief True if the tip reached the voxel of \e pose with the approach direction of \e pose
+  bool isReachable(const Eigen::Affine3d &pose) const;
+
+  /// \brief True if the tip reached any voxel that intersects the box [\e min, \e max]
+  bool isRegionReachable(const Eigen::Vector3d &min, const Eigen::Vector3d &max) const;
+
+  /// \brief True if the box [\e min, \e max] intersects the grid of the map.  The grid bounds all the
+  /// positions the tip reached while the map was built.
+  bool isRegionInside(const Eigen::Vector3d &min, const Eigen::Vector3d &max) const;
+
+  /// \brief A score in [0, 1] for \e pose: 0 if it is not reachable, otherwise the IK success rate of its
+  /// voxel (1 if unknown) weighted by the manipulability of the voxel relative to the best voxel
+  double getScore(const Eigen::Affine3d &pose) const;
+
+  /// \brief The approach direction bin of \e pose
+  static unsigned int getOrientationBin(const Eigen::Affine3d &pose);
+
+private:
+
+  bool getIndex(const Eigen::Vector3d &position, int index[3]) const;
+  /// \brief The range of voxel indices of the box [\e min, \e max], clipped to the grid; false if it is empty
+  bool getIndexRange(const Eigen::Vector3d &min, const Eigen::Vector3d &max, int low[3], int high[3]) const;
+
+  std::string          group_;
+  std::string          base_frame_;
+  std::string          tip_frame_;
+  double               resolution_;
+  Eigen::Vector3d      origin_;
+  int                  size_[3];
+  float                max_manipulability_;
+  std::vector<Cell>    cells_;
+};
+
+typedef std::shared_ptr<ReachabilityMap> ReachabilityMapPtr;
+typedef std::shared_ptr<const ReachabilityMap> ReachabilityMapConstPtr;
+
+}
+
+#endif
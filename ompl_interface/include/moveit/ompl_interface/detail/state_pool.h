@@ -0,0 +1,134 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_STATE_POOL_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_STATE_POOL_
+
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace ompl_interface
+{
+
+/** @class StatePool
+    @brief A pool of fixed size memory blocks, used to allocate states as a single block.
+    Memory is obtained in chunks of many blocks, so states allocated together are close in memory.
+    Freed blocks are kept on free lists for reuse.  To reduce contention, the pool is split in
+    shards, each with its own lock and free list; every thread allocates from one shard.  Each
+    block has a small header that records the shard it was carved from, and freed blocks are
+    returned to that shard, so memory does not pile up on the threads that free states.  The
+    memory is returned to the system by release(), by trim() for the chunks whose blocks are all
+    free, or when the pool is destroyed. */
+class StatePool : private boost::noncopyable
+{
+public:
+
+  StatePool(std::size_t block_size, std::size_t blocks_per_chunk = 256);
+  ~StatePool();
+
+  /// \brief Return a block of getBlockSize() bytes, aligned for any type
+  void* allocate();
+
+  /// \brief Return a block obtained from allocate() to the pool
+  void free(void *block);
+
+  /// \brief Release all memory of the pool, if no blocks are in use.  Returns true if the memory was released.
+  bool release();
+
+  /// \brief Return the chunks whose blocks are all free to the system, even if other blocks are in use.
+  /// Returns the number of bytes released.
+  std::size_t trim();
+
+  /// \brief Change the size of the blocks.  Only possible when no blocks are in use; returns false otherwise.
+  bool setBlockSize(std::size_t block_size);
+
+  std::size_t getBlockSize() const
+  {
+    return block_size_;
+  }
+
+  /// \brief Number of blocks currently in use
+  std::size_t getBlocksInUse() const
+  {
+    return in_use_;
+  }
+
+  /// \brief Highest number of blocks in use at the same time, since construction or resetPeakBlocksInUse()
+  std::size_t getPeakBlocksInUse() const
+  {
+    return peak_in_use_;
+  }
+
+  /// \brief Start tracking the peak from the number of blocks currently in use
+  void resetPeakBlocksInUse()
+  {
+    peak_in_use_ = in_use_.load();
+  }
+
+  /// \brief Number of bytes obtained from the system
+  std::size_t getReservedMemory() const;
+
+private:
+
+  static const unsigned int SHARD_COUNT = 8;
+
+  struct Shard
+  {
+    Shard() : free_list(NULL)
+    {
+    }
+
+    mutable boost::mutex     lock;
+    void                    *free_list;
+    /// \brief The chunks of the shard; NULL for chunks released by trim(), whose slots are reused
+    std::vector<char*>       chunks;
+    /// \brief The number of blocks of each chunk that are in use
+    std::vector<std::size_t> chunk_blocks_in_use;
+  };
+
+  void freeChunks();
+
+  /// \brief The size of the blocks handed out, excluding the header
+  std::size_t               block_size_;
+  std::size_t               blocks_per_chunk_;
+  Shard                     shards_[SHARD_COUNT];
+  boost::atomic<std::size_t> in_use_;
+  boost::atomic<std::size_t> peak_in_use_;
+};
+
+}
+
+#endif
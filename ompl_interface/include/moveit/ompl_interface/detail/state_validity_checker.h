@@ -38,6 +38,8 @@
 #define MOVEIT_OMPL_INTERFACE_DETAIL_STATE_VALIDITY_CHECKER_
 
 #include "moveit/ompl_interface/detail/threadsafe_state_storage.h"
+#include "moveit/ompl_interface/detail/state_validity_statistics.h"
+#include "moveit/ompl_interface/detail/memory_usage.h"
 #include <moveit/collision_detection/collision_common.h>
 #include <ompl/base/StateValidityChecker.h>
 
@@ -54,6 +56,7 @@ public:
 
   StateValidityChecker(const OMPLPlanningContext *planning_context);
 
+  virtual ~StateValidityChecker();
 
   virtual bool isValid(const ompl::base::State *state) const
   {
@@ -73,8 +76,46 @@ public:
 
   void setVerbose(bool flag);
 
+  /// \brief When enabled (and the validity cache is in use), every collision query computes validity,
+  /// distance and cost at once and stores them with the state.  Useful for optimizing planners, which
+  /// query validity, cost and clearance of the same states.
+  void setCombinedEvaluation(bool flag);
+
+  bool getCombinedEvaluation() const
+  {
+    return combined_evaluation_;
+  }
+
+  /// \brief Add the statistics gathered by all threads to \e stats.  If \e reset is true, the
+  /// statistics of this checker are cleared.  Call this when no thread is checking states.
+  void collectStatistics(StateValidityStatistics &stats, bool reset = true) const;
+
+  /// \brief Add the memory of this checker to \e report: "robot_states" for the per-thread robot
+  /// states and "validity_statistics" for the per-thread statistics
+  void getMemoryUsage(MemoryUsageReport &report) const;
+
 protected:
 
+  /// \brief Return the statistics of the calling thread, or NULL if statistics are disabled
+  StateValidityStatistics* getThreadStatistics() const;
+
+  // The stages of validity checking; each accumulates its time into \e stats (if not NULL)
+  bool checkBounds(const ompl::base::State *state, bool verbose, StateValidityStatistics *stats) const;
+  bool checkJointPathConstraints(const ompl::base::State *state, bool verbose, double *dist, StateValidityStatistics *stats) const;
+  robot_state::RobotState* getRobotState(const ompl::base::State *state, StateValidityStatistics *stats) const;
+  bool checkPathConstraints(const robot_state::RobotState &kstate, bool verbose, double *dist, StateValidityStatistics *stats) const;
+  bool checkFeasibility(const robot_state::RobotState &kstate, bool verbose, StateValidityStatistics *stats) const;
+  void checkCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res,
+                      const robot_state::RobotState &kstate, StateValidityStatistics *stats) const;
+
+  /// \brief Evaluate bounds, path constraints, feasibility and, if those pass, collision with distance
+  /// and, if \e with_cost is true, cost in a single query.  The results are stored in \e state.
+  /// Returns the validity of the state.
+  bool evaluate(const ompl::base::State *state, bool verbose, bool with_cost) const;
+
+  /// \brief Compute the cost of a state from the cost sources of a collision result
+  static double computeCost(const collision_detection::CollisionResult &res);
+
   bool isValidWithoutCache(const ompl::base::State *state, bool verbose) const;
   bool isValidWithoutCache(const ompl::base::State *state, double &dist, bool verbose) const;
 
@@ -90,7 +131,19 @@ protected:
   collision_detection::CollisionRequest collision_request_with_distance_verbose_;
 
   collision_detection::CollisionRequest collision_request_with_cost_;
+  collision_detection::CollisionRequest collision_request_combined_;
+  collision_detection::CollisionRequest collision_request_combined_verbose_;
   bool                                  verbose_;
+  bool                                  combined_evaluation_;
+
+  /// \brief Joint-only path constraints, checked before the robot state is computed.  When set,
+  /// the path constraints of the planning context are not evaluated on the robot state.
+  JointPathConstraintTableConstPtr      joint_path_constraints_;
+
+  /// \brief Unique identifier of this instance, used to find the statistics of the calling thread
+  unsigned long                         id_;
+  mutable std::map<boost::thread::id, StateValidityStatistics*> thread_statistics_;
+  mutable boost::mutex                  statistics_lock_;
 };
 
 }
@@ -0,0 +1,158 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_STATE_VALIDITY_STATISTICS_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_STATE_VALIDITY_STATISTICS_
+
+#include <chrono>
+#include <iostream>
+
+namespace ompl_interface
+{
+
+/// \brief Counters and cumulative times for the stages of state validity checking.
+/// Collection can be disabled at compile time by building without
+/// MOVEIT_OMPL_INTERFACE_VALIDITY_STATISTICS (CMake option OMPL_INTERFACE_VALIDITY_STATISTICS).
+struct StateValidityStatistics
+{
+  enum Stage
+  {
+    BOUNDS = 0,        // satisfiesBounds()
+    ROBOT_STATE,       // copyToRobotState(), including forward kinematics
+    PATH_CONSTRAINTS,  // KinematicConstraintSet::decide()
+    FEASIBILITY,       // PlanningScene::isStateFeasible()
+    COLLISION,         // PlanningScene::checkCollision()
+    STAGE_COUNT
+  };
+
+  StateValidityStatistics()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    for (int i = 0 ; i < STAGE_COUNT ; ++i)
+    {
+      counts[i] = 0;
+      times[i] = 0.0;
+    }
+    cache_hits = 0;
+    cache_misses = 0;
+  }
+
+  void merge(const StateValidityStatistics &other)
+  {
+    for (int i = 0 ; i < STAGE_COUNT ; ++i)
+    {
+      counts[i] += other.counts[i];
+      times[i] += other.times[i];
+    }
+    cache_hits += other.cache_hits;
+    cache_misses += other.cache_misses;
+  }
+
+  /// \brief Total time (seconds) spent in all stages
+  double getTotalTime() const
+  {
+    double t = 0.0;
+    for (int i = 0 ; i < STAGE_COUNT ; ++i)
+      t += times[i];
+    return t;
+  }
+
+  static const char* getStageName(Stage stage)
+  {
+    static const char *names[STAGE_COUNT] = { "bounds", "robot_state", "path_constraints", "feasibility", "collision" };
+    return names[stage];
+  }
+
+  void print(std::ostream &out) const
+  {
+    for (int i = 0 ; i < STAGE_COUNT ; ++i)
+      out << getStageName(static_cast<Stage>(i)) << ": " << counts[i] << " calls, " << times[i] << " s" << std::endl;
+    out << "cache: " << cache_hits << " hits, " << cache_misses << " misses" << std::endl;
+  }
+
+  /// \brief Number of times each stage was executed
+  unsigned long counts[STAGE_COUNT];
+
+  /// \brief Cumulative time (seconds) spent in each stage
+  double times[STAGE_COUNT];
+
+  /// \brief Validity queries answered from the state cache
+  unsigned long cache_hits;
+
+  /// \brief Validity queries that required evaluation
+  unsigned long cache_misses;
+};
+
+/// \brief Accumulates the time spent in its scope into a stage of \e stats (if not NULL)
+class ScopedStageTimer
+{
+public:
+
+#ifdef MOVEIT_OMPL_INTERFACE_VALIDITY_STATISTICS
+  ScopedStageTimer(StateValidityStatistics *stats, StateValidityStatistics::Stage stage)
+    : stats_(stats)
+    , stage_(stage)
+  {
+    if (stats_)
+      start_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedStageTimer()
+  {
+    if (stats_)
+    {
+      stats_->counts[stage_]++;
+      stats_->times[stage_] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+  }
+
+private:
+
+  StateValidityStatistics                    *stats_;
+  StateValidityStatistics::Stage              stage_;
+  std::chrono::steady_clock::time_point     start_;
+#else
+  ScopedStageTimer(StateValidityStatistics*, StateValidityStatistics::Stage)
+  {
+  }
+#endif
+};
+
+}
+
+#endif
@@ -39,10 +39,16 @@
 
 #include <moveit/robot_state/robot_state.h>
 #include <boost/thread.hpp>
+#include <memory>
+#include <vector>
 
 namespace ompl_interface
 {
 
+/// \brief Storage for one RobotState per thread.  Each thread finds its state without locking,
+/// through a small thread local cache; the lock is only taken the first time a thread asks for
+/// a state (or when its cache entry was evicted).  States of threads that exit are reused by
+/// new threads and all states are freed when the storage is destroyed.
 class TSStateStorage
 {
 public:
@@ -53,11 +59,28 @@ public:
 
   robot_state::RobotState* getStateStorage() const;
 
+  /// \brief Number of states allocated so far (one per thread that used the storage)
+  std::size_t getStateCount() const;
+
+  /// \brief Estimate of the bytes used by the allocated states: their variables and link transforms
+  std::size_t getMemoryUsage() const;
+
 private:
 
+  robot_state::RobotState* allocStateStorage() const;
+
+  struct Slot
+  {
+    /// \brief Token of the thread using the state; expires when the thread exits
+    std::weak_ptr<void>      owner;
+    robot_state::RobotState *state;
+  };
+
   robot_state::RobotState                                       start_state_;
-  mutable std::map<boost::thread::id, robot_state::RobotState*> thread_states_;
-  mutable boost::mutex                                                  lock_;
+  /// \brief Unique identifier of this instance, used as key in the thread local caches
+  unsigned long                                                 id_;
+  mutable std::vector<Slot>                                     slots_;
+  mutable boost::mutex                                          lock_;
 };
 
 }
@@ -0,0 +1,96 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_DETAIL_WORKER_POOL_
+#define MOVEIT_OMPL_INTERFACE_DETAIL_WORKER_POOL_
+
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <deque>
+
+namespace ompl_interface
+{
+
+/** @class WorkerPool
+    @brief A fixed set of threads that run the iterations of short parallel loops.  The thread calling
+    run() executes iterations as well, so the pool never blocks waiting for itself, and run() can be
+    called from several threads at the same time. */
+class WorkerPool : private boost::noncopyable
+{
+public:
+
+  typedef boost::function<void(unsigned int)> Task;
+
+  explicit WorkerPool(unsigned int thread_count);
+  ~WorkerPool();
+
+  /// \brief Call \e task for every index in [0, \e count), concurrently.  Returns when all calls completed.
+  void run(unsigned int count, const Task &task);
+
+  unsigned int getThreadCount() const
+  {
+    return threads_.size();
+  }
+
+private:
+
+  struct Job
+  {
+    const Task   *task;
+    unsigned int  count;
+    unsigned int  next;
+    unsigned int  done;
+  };
+
+  void worker();
+
+  /// \brief Take the next iteration of the job at the front of the queue; the lock must be held.
+  /// Returns false if the queue is empty.
+  bool claim(Job *&job, unsigned int &index);
+
+  /// \brief Execute an iteration and record its completion
+  void execute(Job *job, unsigned int index);
+
+  boost::thread_group       threads_;
+  std::deque<Job*>          jobs_;
+  boost::mutex              lock_;
+  boost::condition_variable work_available_;
+  boost::condition_variable work_done_;
+  bool                      stop_;
+};
+
+}
+
+#endif
@@ -39,6 +39,11 @@
 
 #include <ros/ros.h>
 #include "moveit/ompl_interface/ompl_planning_context.h"
+#include "moveit/ompl_interface/detail/bisection_motion_validator.h"
+#include "moveit/ompl_interface/detail/state_validity_statistics.h"
+#include "moveit/ompl_interface/detail/joint_space_nearest_neighbors.h"
+#include "moveit/ompl_interface/detail/memory_usage.h"
+#include "moveit/ompl_interface/detail/constrained_sample_producer.h"
 //#include "moveit/ompl_interface/constraints_library.h"
 #include <ompl/geometric/SimpleSetup.h>
 #include <boost/thread/mutex.hpp>
@@ -96,6 +101,21 @@ public:
     /// \brief Return the set of constraints that must be satisfied along the entire path
     virtual const kinematic_constraints::KinematicConstraintSetPtr& getPathConstraints() const;
 
+    virtual JointPathConstraintTableConstPtr getJointPathConstraints() const;
+
+    virtual ReachabilityMapConstPtr getReachabilityMap() const;
+
+    /// \brief Return the state validity statistics gathered during the last call to solve(),
+    /// including simplification of the solution
+    const StateValidityStatistics& getStateValidityStatistics() const;
+
+    /// \brief Measure the memory held by this context and return it by component, with the peaks
+    /// observed over the lifetime of the context.  "states" covers every state allocated from the state
+    /// space, including goal states and the vertices of the planner; the "goal_states" and "planner"
+    /// entries only count the bookkeeping of those.  Measuring the planner requires extracting its
+    /// planner data, so it is only done if \e include_planner is true; the rest is cheap.
+    const MemoryUsageReport& getMemoryUsage(bool include_planner = false);
+
     // TODO: Remove this.
     // ConstraintsLibraryPtr getConstraintsLibrary() const;
 
@@ -124,6 +144,10 @@ protected:
     /// the constraints specified in the motion plan request.
     virtual ompl::base::StateSamplerPtr allocPathConstrainedSampler(const ompl::base::StateSpace* ss) const;
 
+    /// \brief Select a constraint sampler for the path constraints.  Returns NULL if there are no
+    /// path constraints or no sampler is able to sample them.
+    constraint_samplers::ConstraintSamplerPtr selectPathConstraintSampler() const;
+
     /// \brief A method that is invoked immediately before every call to solve()
     virtual void preSolve();
 
@@ -141,6 +165,13 @@ protected:
     /// \brief Stop the goal sampling thread
     void stopGoalSampling();
 
+    /// \brief Store the goal states found by the goal samplers in the goal sample cache, if there is one
+    void storeGoalSamples();
+
+    /// \brief Merge the statistics of the state validity checker into validity_statistics_ and
+    /// reset those of the checker
+    void collectValidityStatistics();
+
     /// \brief Set the currently running termination condition.  Used for terminate()
     void registerTerminationCondition(const ompl::base::PlannerTerminationCondition &ptc);
 
@@ -162,6 +193,10 @@ protected:
     /// \brief Return an instance of the given planner_name configured with the given parameters
     virtual ompl::base::PlannerPtr configurePlanner(const std::string& planner_name, const std::map<std::string, std::string>& params);
 
+    /// \brief Make \e planner use NearestNeighborsJointSpace, if the state space supports it and
+    /// the planner is one of the tree planners that accept it
+    virtual void setNearestNeighbors(const ompl::base::PlannerPtr &planner) const;
+
     /// \brief Configure a new projection evaluator given the string encoding
     virtual ompl::base::ProjectionEvaluatorPtr getProjectionEvaluator(const std::string &peval) const;
 
@@ -174,6 +209,22 @@ protected:
     /// \brief Pointer to the (derived) OMPL StateSpace object
     ModelBasedStateSpacePtr mbss_;
 
+    /// \brief The motion validator.  Caches segment validity for the duration of a solve.
+    BisectionMotionValidatorPtr motion_validator_;
+
+    /// \brief The metric of the state space, when nearest neighbors can be computed in joint space
+    JointSpaceMetricPtr joint_space_metric_;
+
+    /// \brief Background threads sampling the path constraints during solve, if enabled with the
+    /// constrained_sampling_threads parameter.  Declared after mbss_, as it holds states of the space.
+    ConstrainedSampleProducerPtr sample_producer_;
+
+    /// \brief State validity statistics for the last solve
+    StateValidityStatistics validity_statistics_;
+
+    /// \brief Memory usage by component, as of the last call to getMemoryUsage()
+    MemoryUsageReport memory_usage_;
+
     /// \brief Robot state containing the initial position of all joints
     robot_state::RobotState* complete_initial_robot_state_;
 
@@ -183,6 +234,15 @@ protected:
     /// \brief The (possibly empty) set of constraints that must be satisfied along the entire path.
     kinematic_constraints::KinematicConstraintSetPtr path_constraints_;
 
+    /// \brief The path constraints compiled into joint intervals, if they are all joint constraints
+    /// on the group.  Evaluated directly on OMPL states.
+    JointPathConstraintTablePtr joint_path_constraints_;
+
+    /// \brief The maximum extent of the group within its joint limits.  The bounds of the state space
+    /// may be narrowed by joint path constraints; the motion check resolution and the waypoint
+    /// spacing of solutions are still relative to this extent.
+    double unrestricted_extent_;
+
     /// \brief The constraint sampler factory.
     constraint_samplers::ConstraintSamplerManagerPtr constraint_sampler_manager_;
 
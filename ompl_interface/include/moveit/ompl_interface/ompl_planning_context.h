@@ -44,6 +44,10 @@
 #include <ompl/base/SpaceInformation.h>
 #include <ompl/base/ProblemDefinition.h>
 #include "moveit/ompl_interface/parameterization/model_based_state_space.h"
+#include "moveit/ompl_interface/detail/joint_path_constraint_table.h"
+#include "moveit/ompl_interface/detail/reachability_map.h"
+#include "moveit/ompl_interface/detail/goal_sample_cache.h"
+#include <boost/lexical_cast.hpp>
 
 namespace ompl_interface
 {
@@ -63,6 +67,8 @@ struct PlanningContextSpecification
 
     robot_model::RobotModelConstPtr model;      // the robot model
     constraint_samplers::ConstraintSamplerManagerPtr constraint_sampler_mgr; // Constraint sampler loaders
+    ReachabilityMapConstPtr reachability_map;   // the reachability map of the group, if one was loaded
+    GoalSampleCachePtr goal_sample_cache;       // goal states of earlier requests, shared by all contexts (may be NULL)
 };
 
 /// \brief Definition of an OMPL-specific planning context.  This context is
@@ -70,7 +76,9 @@ struct PlanningContextSpecification
 class OMPLPlanningContext : public planning_interface::PlanningContext
 {
 public:
-    OMPLPlanningContext() : planning_interface::PlanningContext("UNINITIALIZED", "NO_GROUP"), use_state_validity_cache_(true) {}
+    OMPLPlanningContext() : planning_interface::PlanningContext("UNINITIALIZED", "NO_GROUP"), use_state_validity_cache_(true),
+                            max_goal_samples_(50), max_goal_sampling_attempts_(1000), max_state_sampling_attempts_(4),
+                            goal_sampling_threads_(1) {}
 
     virtual ~OMPLPlanningContext() {}
 
@@ -83,6 +91,20 @@ public:
     {
         name_ = spec.name;
         group_ = spec.group;
+
+        // Sampling limits; the values are numbers, possibly written as doubles by the parameter server
+        std::map<std::string, std::string>::const_iterator it = spec.config.find("max_goal_samples");
+        if (it != spec.config.end())
+            max_goal_samples_ = (unsigned int)boost::lexical_cast<double>(it->second);
+        it = spec.config.find("max_goal_sampling_attempts");
+        if (it != spec.config.end())
+            max_goal_sampling_attempts_ = (unsigned int)boost::lexical_cast<double>(it->second);
+        it = spec.config.find("max_state_sampling_attempts");
+        if (it != spec.config.end())
+            max_state_sampling_attempts_ = (unsigned int)boost::lexical_cast<double>(it->second);
+        it = spec.config.find("goal_sampling_threads");
+        if (it != spec.config.end())
+            goal_sampling_threads_ = std::max(1u, (unsigned int)boost::lexical_cast<double>(it->second));
     }
 
     /// \brief Solve the motion planning problem and store the result in \e res.
@@ -130,6 +152,43 @@ public:
     /// \brief Return the set of constraints that must be satisfied along the entire path
     virtual const kinematic_constraints::KinematicConstraintSetPtr& getPathConstraints() const = 0;
 
+    /// \brief Return the path constraints compiled into a table of joint intervals, if the path
+    /// constraints allow it.  When this is not NULL, it is equivalent to getPathConstraints().
+    virtual JointPathConstraintTableConstPtr getJointPathConstraints() const
+    {
+        return JointPathConstraintTableConstPtr();
+    }
+
+    /// \brief Return the reachability map of the group being planned for, if there is one
+    virtual ReachabilityMapConstPtr getReachabilityMap() const
+    {
+        return ReachabilityMapConstPtr();
+    }
+
+    /// \brief The number of goal states a goal sampler collects before it stops sampling
+    unsigned int getMaximumGoalSamples() const
+    {
+        return max_goal_samples_;
+    }
+
+    /// \brief The number of attempts a goal sampler makes before it stops sampling
+    unsigned int getMaximumGoalSamplingAttempts() const
+    {
+        return max_goal_sampling_attempts_;
+    }
+
+    /// \brief The number of attempts passed to a constraint sampler for a single sample
+    unsigned int getMaximumStateSamplingAttempts() const
+    {
+        return max_state_sampling_attempts_;
+    }
+
+    /// \brief The number of threads sampling each goal region
+    unsigned int getGoalSamplingThreads() const
+    {
+        return goal_sampling_threads_;
+    }
+
     /// \brief Return true if caching is enabled in the StateValidityChecker
     bool useStateValidityCache() const
     {
@@ -146,6 +205,12 @@ protected:
 
     /// \brief Flag indicating whether caching is used in the StateValidityChecker.
     bool use_state_validity_cache_;
+
+    /// \brief The sampling limits; see the corresponding getters
+    unsigned int max_goal_samples_;
+    unsigned int max_goal_sampling_attempts_;
+    unsigned int max_state_sampling_attempts_;
+    unsigned int goal_sampling_threads_;
 };
 
 }
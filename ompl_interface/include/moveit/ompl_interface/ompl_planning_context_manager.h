@@ -46,6 +46,7 @@
 #include <moveit/constraint_samplers/constraint_sampler_manager.h>
 #include <moveit/constraint_sampler_manager_loader/constraint_sampler_manager_loader.h>
 #include <moveit/ompl_interface/ompl_planning_context.h>
+#include <moveit/ompl_interface/detail/memory_usage.h>
 //#include <moveit_planners_ompl/OMPLDynamicReconfigureConfig.h>
 #include <moveit_ompl_planning_interface/OMPLDynamicReconfigureConfig.h>
 
@@ -83,7 +84,10 @@ public:
     /// \brief Determine whether this plugin instance is able to represent this planning request
     virtual bool canServiceRequest(const planning_interface::MotionPlanRequest &req) const;
 
-
+    /// \brief Measure the memory held by this manager across requests ("goal_sample_cache" and
+    /// "reachability_maps") and return it by component, with the peaks observed over the lifetime
+    /// of the manager.  The memory of planning contexts is reported by the contexts themselves.
+    const MemoryUsageReport& getMemoryUsage();
 
 protected:
     /// \brief Retrieve an instance of a planning context given the configuration settings
@@ -92,6 +96,9 @@ protected:
     /// \brief Read planning context information from the ROS param server
     void configurePlanningContexts();
 
+    /// \brief Load the reachability maps of the groups that have the reachability_map parameter
+    void loadReachabilityMaps();
+
     /// \brief Read planning group context parameters from the ROS param server
     void getGroupSpecificParameters(const std::string& group_name,
                                     std::map<std::string, std::string>& specific_group_params);
@@ -122,6 +129,13 @@ private:
     constraint_samplers::ConstraintSamplerManagerPtr constraint_sampler_manager_;
 
     boost::scoped_ptr<dynamic_reconfigure::Server<moveit_ompl_planning_interface::OMPLDynamicReconfigureConfig> > dynamic_reconfigure_server_;
+    /// \brief Reachability maps by group, loaded once at initialization
+    std::map<std::string, ReachabilityMapConstPtr> reachability_maps_;
+    /// \brief Goal states of earlier requests, reused by requests for the same goal.  NULL if disabled.
+    GoalSampleCachePtr goal_sample_cache_;
+    /// \brief Memory usage by component, as of the last call to getMemoryUsage()
+    MemoryUsageReport memory_usage_;
+
     bool simplify_;
     bool interpolate_;
     unsigned int min_waypoint_count_;
@@ -0,0 +1,145 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#ifndef MOVEIT_OMPL_INTERFACE_FIXED_JOINT_MODEL_STATE_SPACE_
+#define MOVEIT_OMPL_INTERFACE_FIXED_JOINT_MODEL_STATE_SPACE_
+
+#include "moveit/ompl_interface/parameterization/joint_space/joint_model_state_space.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace ompl_interface
+{
+
+/// \brief Allocate a joint space state space for \e spec.  For groups with a number of variables for
+/// which FixedJointModelStateSpace is instantiated (6, 7, 12 and 14), that specialization is used.
+JointModelStateSpace* allocJointModelStateSpace(const ModelBasedStateSpaceSpecification &spec);
+
+/** @class FixedJointModelStateSpace
+    @brief A JointModelStateSpace for groups with exactly N variables.  Copying states uses loops of
+    known length.  For groups of bounded single-variable joints (see ModelBasedStateSpace), distance,
+    interpolation, equality and bound checks are also loops of known length that the compiler unrolls.
+    Other groups use the generic implementations for those. */
+template<unsigned int N>
+class FixedJointModelStateSpace : public JointModelStateSpace
+{
+public:
+
+  FixedJointModelStateSpace(const ModelBasedStateSpaceSpecification &spec)
+    : JointModelStateSpace(spec)
+  {
+    if (variable_count_ != N)
+      throw std::runtime_error("FixedJointModelStateSpace: group '" + getJointModelGroupName() + "' does not have the expected number of variables");
+    for (unsigned int i = 0 ; i < N ; ++i)
+    {
+      weights_[i] = simple_joints_ ? simple_joint_weights_[i] : 0.0;
+      lower_[i] = simple_joints_ ? simple_joint_lower_[i] : 0.0;
+      upper_[i] = simple_joints_ ? simple_joint_upper_[i] : 0.0;
+    }
+  }
+
+  virtual void copyState(ompl::base::State *destination, const ompl::base::State *source) const
+  {
+    StateType *d = destination->as<StateType>();
+    const StateType *s = source->as<StateType>();
+    for (unsigned int i = 0 ; i < N ; ++i)
+      d->values[i] = s->values[i];
+    d->tag = s->tag;
+    d->flags = s->flags;
+    d->distance = s->distance;
+    d->cost = s->cost;
+  }
+
+  virtual double distance(const ompl::base::State *state1, const ompl::base::State *state2) const
+  {
+    if (distance_function_ || !simple_joints_)
+      return JointModelStateSpace::distance(state1, state2);
+    const double *a = state1->as<StateType>()->values;
+    const double *b = state2->as<StateType>()->values;
+    double d = 0.0;
+    for (unsigned int i = 0 ; i < N ; ++i)
+      d += fabs(a[i] - b[i]) * weights_[i];
+    return d;
+  }
+
+  virtual void interpolate(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const
+  {
+    if (interpolation_function_ || !simple_joints_)
+    {
+      JointModelStateSpace::interpolate(from, to, t, state);
+      return;
+    }
+
+    // clear any cached info (such as validity known or not)
+    state->as<StateType>()->clearKnownInformation();
+    const double *f = from->as<StateType>()->values;
+    const double *g = to->as<StateType>()->values;
+    double *v = state->as<StateType>()->values;
+    for (unsigned int i = 0 ; i < N ; ++i)
+      v[i] = f[i] + (g[i] - f[i]) * t;
+    interpolateTag(from, to, t, state);
+  }
+
+  virtual bool equalStates(const ompl::base::State *state1, const ompl::base::State *state2) const
+  {
+    const double *a = state1->as<StateType>()->values;
+    const double *b = state2->as<StateType>()->values;
+    bool equal = true;
+    for (unsigned int i = 0 ; i < N ; ++i)
+      equal &= fabs(a[i] - b[i]) <= std::numeric_limits<double>::epsilon();
+    return equal;
+  }
+
+  virtual bool satisfiesBounds(const ompl::base::State *state) const
+  {
+    if (!simple_joints_)
+      return JointModelStateSpace::satisfiesBounds(state);
+    const double *v = state->as<StateType>()->values;
+    bool within = true;
+    for (unsigned int i = 0 ; i < N ; ++i)
+      within &= v[i] >= lower_[i] && v[i] <= upper_[i];
+    return within;
+  }
+
+protected:
+
+  double weights_[N];
+  double lower_[N];
+  double upper_[N];
+};
+
+}
+
+#endif
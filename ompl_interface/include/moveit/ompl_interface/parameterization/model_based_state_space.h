@@ -42,6 +42,8 @@
 #include <moveit/robot_state/robot_state.h>
 #include <moveit/kinematic_constraints/kinematic_constraint.h>
 #include <moveit/constraint_samplers/constraint_sampler.h>
+#include "moveit/ompl_interface/detail/state_pool.h"
+#include "moveit/ompl_interface/detail/memory_usage.h"
 
 namespace ompl_interface
 {
@@ -82,7 +84,8 @@ public:
         GOAL_DISTANCE_KNOWN = 2,
         VALIDITY_TRUE = 4,
         IS_START_STATE = 8,
-        IS_GOAL_STATE = 16
+        IS_GOAL_STATE = 16,
+        COST_KNOWN = 32
       };
 
     StateType()
@@ -91,6 +94,7 @@ public:
       , tag(-1)
       , flags(0)
       , distance(0.0)
+      , cost(0.0)
     {
     }
 
@@ -139,6 +143,17 @@ public:
       return flags & GOAL_DISTANCE_KNOWN;
     }
 
+    void markCost(double c)
+    {
+      cost = c;
+      flags |= COST_KNOWN;
+    }
+
+    bool isCostKnown() const
+    {
+      return flags & COST_KNOWN;
+    }
+
     bool isStartState() const
     {
       return flags & IS_START_STATE;
@@ -168,6 +183,7 @@ public:
     int tag;
     int flags;
     double distance;
+    double cost;
   };
 
   ModelBasedStateSpace(const ModelBasedStateSpaceSpecification &spec);
@@ -183,6 +199,11 @@ public:
     distance_function_ = fun;
   }
 
+  const DistanceFunction& getDistanceFunction() const
+  {
+    return distance_function_;
+  }
+
   virtual bool isMetricSpace() const
   {
       return false;
@@ -196,6 +217,19 @@ public:
 
   virtual void copyState(ompl::base::State *destination, const ompl::base::State *source) const;
   virtual void interpolate(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const;
+
+  /// Compute the states at fractions 1/count, ..., (count-1)/count of the motion from \e from to \e to.
+  /// \e states must hold count - 1 allocated states.  Spaces where interpolated states depend on each
+  /// other (e.g., through IK) compute them in order along the motion, and may stop at the first state that
+  /// fails: the states after it are then marked invalid without being computed.  By default interpolate() is used.
+  virtual void interpolateSegment(const ompl::base::State *from, const ompl::base::State *to, unsigned int count,
+                                  ompl::base::State **states) const;
+
+  /// True if interpolateSegment() is cheaper or more accurate than interpolating each state separately
+  virtual bool hasSequentialInterpolation() const
+  {
+    return false;
+  }
   virtual double distance(const ompl::base::State *state1, const ompl::base::State *state2) const;
   virtual bool equalStates(const ompl::base::State *state1, const ompl::base::State *state2) const;
   virtual double getMaximumExtent() const;
@@ -206,6 +240,16 @@ public:
   virtual void deserialize(ompl::base::State *state, const void *serialization) const;
   virtual double* getValueAddressAtIndex(ompl::base::State *state, const unsigned int index) const;
 
+  /// Write \e count states to \e out in one pass, in a versioned binary format.  The header identifies
+  /// the group, its variables and the signature of this space; each state is stored as its tag and values.
+  /// Returns false if writing fails.
+  bool storeStates(std::ostream &out, const ompl::base::State * const *states, std::size_t count) const;
+
+  /// Read states written by storeStates() from \e in and append them to \e states.  The states are
+  /// allocated by this space.  Returns false if the data is not in the expected format, was written
+  /// for a different group or space, or is truncated; states read before the error are kept.
+  bool loadStates(std::istream &in, std::vector<ompl::base::State*> &states) const;
+
   virtual ompl::base::StateSamplerPtr allocDefaultStateSampler() const;
 
 
@@ -262,14 +306,62 @@ public:
   double getTagSnapToSegment() const;
   void setTagSnapToSegment(double snap);
 
+  /// Return the memory of the state pool to the system.  This is only possible when no states
+  /// of this space are allocated; returns true if the memory was released.
+  bool releaseStateMemory();
+
+  /// Return the memory of the state pool that holds no allocated states to the system.  Unlike
+  /// releaseStateMemory(), this is possible while states are allocated.  Returns the number of bytes released.
+  std::size_t trimStateMemory();
+
+  /// Add the memory of this space to \e report: "states" for the states currently allocated (the peak
+  /// includes states allocated and freed between calls) and "state_pool" for the memory reserved by the pool.
+  /// Entries already in the report keep their peaks.  This is cheap enough to call after every solve.
+  void getMemoryUsage(MemoryUsageReport &report) const;
+
+  /// Start tracking the peak number of allocated states from the current number
+  void resetStateMemoryPeak();
+
 protected:
 
+  /// Set the tag of \e state, interpolated at \e t between \e from and \e to
+  void interpolateTag(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const;
+
+  /// Set the number of bytes that precede the values in the memory block of a state, and the number
+  /// of doubles that follow the joint values.  The header must include the StateType of the derived
+  /// space.  This must be set before any state is allocated.
+  void setStateLayout(std::size_t header_size, std::size_t extra_values = 0);
+
+  /// Allocate the memory block of a state.  The StateType is constructed at the start of the block.
+  void* allocStateBlock() const
+  {
+    return state_pool_.allocate();
+  }
+
+  /// Return the location of the values within the memory block of a state
+  double* getStateBlockValues(void *block) const
+  {
+    return reinterpret_cast<double*>(static_cast<char*>(block) + state_values_offset_);
+  }
+
   ModelBasedStateSpaceSpecification spec_;
   std::vector<robot_model::JointModel::Bounds> joint_bounds_storage_;
   std::vector<const robot_model::JointModel*> joint_model_vector_;
   unsigned int variable_count_;
   size_t state_values_size_;
 
+  /// True if all joints of the group are bounded revolute or prismatic joints with one variable each, in
+  /// the order of the values.  Distance, interpolation and bound checks then use the kernels of joint_space_kernels.h.
+  bool simple_joints_;
+  /// Distance factor, lower and upper bound (including the bounds margin) of each value, when simple_joints_ is true
+  std::vector<double> simple_joint_weights_;
+  std::vector<double> simple_joint_lower_;
+  std::vector<double> simple_joint_upper_;
+
+  /// Each state is allocated as one block from this pool: the StateType, followed by the values
+  mutable StatePool state_pool_;
+  size_t state_values_offset_;
+
   InterpolationFunction interpolation_function_;
   DistanceFunction distance_function_;
 
@@ -38,7 +38,13 @@
 #define MOVEIT_OMPL_INTERFACE_POSE_MODEL_STATE_SPACE_
 
 #include "moveit/ompl_interface/parameterization/model_based_state_space.h"
+#include "moveit/ompl_interface/detail/threadsafe_state_storage.h"
+#include "moveit/ompl_interface/detail/worker_pool.h"
+#include "moveit/ompl_interface/detail/reachability_map.h"
 #include <ompl/base/spaces/SE3StateSpace.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_set.hpp>
 
 namespace ompl_interface
 {
@@ -57,7 +63,8 @@ public:
     enum
       {
         JOINTS_COMPUTED = 256,
-        POSE_COMPUTED = 512
+        POSE_COMPUTED = 512,
+        POSE_FAILED = 1024
       };
 
     StateType()
@@ -88,11 +95,22 @@ public:
     void setPoseComputed(bool value)
     {
       if (value)
-        flags |= POSE_COMPUTED;
+        flags = (flags | POSE_COMPUTED) & ~POSE_FAILED;
       else
         flags &= ~POSE_COMPUTED;
     }
 
+    /// True if FK failed for the joint values of the state, so its poses cannot be computed
+    bool poseFailed() const
+    {
+      return flags & POSE_FAILED;
+    }
+
+    void markPoseFailed()
+    {
+      flags = (flags | POSE_FAILED) & ~POSE_COMPUTED;
+    }
+
     ompl::base::SE3StateSpace::StateType **poses;
   };
 
@@ -103,6 +121,12 @@ public:
   virtual void freeState(ompl::base::State *state) const;
   virtual void copyState(ompl::base::State *destination, const ompl::base::State *source) const;
   virtual void interpolate(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const;
+  virtual void interpolateSegment(const ompl::base::State *from, const ompl::base::State *to, unsigned int count,
+                                  ompl::base::State **states) const;
+  virtual bool hasSequentialInterpolation() const
+  {
+    return true;
+  }
   virtual double distance(const ompl::base::State *state1, const ompl::base::State *state2) const;
   virtual double getMaximumExtent() const;
 
@@ -112,17 +136,97 @@ public:
   bool computeStateIK(ompl::base::State *state) const;
   bool computeStateK(ompl::base::State *state) const;
 
+  /// Interpolated states whose joint values moved more than jump factor times the joint space distance
+  /// of the motion (per step, for interpolateSegment()) are invalid
+  void setJumpFactor(double factor)
+  {
+    jump_factor_ = factor;
+  }
+
+  double getJumpFactor() const
+  {
+    return jump_factor_;
+  }
+
+  /// The smallest joint space distance that is considered a jump, for motions that are very short
+  void setMinimumJump(double jump)
+  {
+    minimum_jump_ = jump;
+  }
+
+  double getMinimumJump() const
+  {
+    return minimum_jump_;
+  }
+
+  /// Forget the poses whose IK failed.  Call this before each solve, since the failures are only
+  /// remembered for the duration of a solve.  Failures of analytic solvers are remembered by pose;
+  /// failures of other solvers by pose and seed.
+  void clearIKFailures();
+
+  /// Number of IK calls answered from the remembered failures since the last clearIKFailures()
+  std::size_t getIKFailureHits() const;
+
+  /// Mark the kinematics solvers as analytic (closed form, with no free joints), or not.  Analytic solvers
+  /// are not retried with searchPositionIK() when getPositionIK() fails, and their failures do not depend on
+  /// the seed.  By default solvers are not considered analytic (analytic_kinematics group parameter).
+  void setAnalyticIK(bool analytic);
+
+  /// Bias uniform sampling towards the poses that \e map scores well (reachable, well conditioned, reliable IK).
+  /// Only used for a single pose component, when the frames of its kinematics solver match those of the map.
+  void setReachabilityMap(const ReachabilityMapConstPtr &map);
+
+  /// The score of the pose of \e state in the reachability map; 1 if there is no map.  Computes the pose if needed.
+  double getReachabilityScore(const ompl::base::State *state) const;
+
   virtual void setPlanningVolume(double minX, double maxX, double minY, double maxY, double minZ, double maxZ);
   virtual void copyToOMPLState(ompl::base::State *state, const robot_state::RobotState &rstate) const;
   virtual void sanityChecks() const;
 
 private:
 
+  /// Compute the poses of \e state if they are not known yet.  Poses are computed on demand, the first time
+  /// they are needed, and memoized with the POSE_COMPUTED flag; the state is updated even though it is const.
+  /// The flags and poses are not synchronized, so this is only safe for states used by a single thread.  States
+  /// that are shared always have their poses: copyToOMPLState() (start and goal states) and copyState() (the
+  /// states planners store) compute them eagerly, and interpolated states get them from their endpoints.
+  bool ensurePoseComputed(const ompl::base::State *state) const
+  {
+    const StateType *s = state->as<StateType>();
+    if (s->poseComputed())
+      return true;
+    // a state whose FK already failed is not written to again
+    if (s->poseFailed())
+      return false;
+    return computeStateFK(const_cast<ompl::base::State*>(state));
+  }
+
+  /// Interpolate the joint values of \e state in joint space and its poses in workspace, without IK.
+  /// Returns false (and marks \e state invalid) if the poses of \e from or \e to are not available.
+  bool interpolatePoses(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const;
+
+  /// Quantized poses (followed by the quantized seeds, unless the solver is analytic) for which IK failed.
+  /// The values themselves are stored, so poses whose hashes collide are not confused.
+  struct IKFailureMemo
+  {
+    IKFailureMemo() : hits(0)
+    {
+    }
+
+    boost::mutex                                                                   lock;
+    boost::unordered_set<std::vector<long long>, boost::hash<std::vector<long long> > > poses;
+    std::size_t                                                                    hits;
+  };
+
   struct PoseComponent
   {
     PoseComponent(const robot_model::JointModelGroup *subgroup,
                   const robot_model::JointModelGroup::KinematicsSolver &k);
 
+    /// Compute forward kinematics on the robot model, with the states of \e states, instead of through
+    /// the kinematics solver.  This is only enabled if the tip and base frames of the solver are links of the model.
+    void initializeFK(const robot_model::JointModelGroup *group, const std::shared_ptr<TSStateStorage> &states);
+
     bool computeStateFK(StateType *full_state, unsigned int idx) const;
     bool computeStateIK(StateType *full_state, unsigned int idx) const;
 
@@ -136,10 +240,49 @@ private:
     std::vector<unsigned int> bijection_;
     ompl::base::StateSpacePtr state_space_;
     std::vector<std::string> fk_link_;
+
+    /// Per-thread robot states for forward kinematics; empty if FK goes through the kinematics solver
+    std::shared_ptr<TSStateStorage> fk_states_;
+    /// Index in the robot state of each variable of the kinematics solver, in the order of the solver
+    std::vector<int> fk_variables_;
+    const robot_model::LinkModel *fk_tip_link_;
+    /// The link the solver expresses poses in; NULL for the model frame
+    const robot_model::LinkModel *fk_base_link_;
+
+    /// True if the solver is analytic; its failures are final, so there is no search fallback
+    bool analytic_;
+    /// Quantized poses whose IK failed during the current solve; shared by the copies of the component
+    std::shared_ptr<IKFailureMemo> ik_failures_;
+  };
+
+  /// The SE3 state of a pose component, with its subcomponents, as stored in the memory block of a
+  /// state.  The position values are stored after the joint values of the state.
+  struct PoseStorage
+  {
+    ompl::base::SE3StateSpace::StateType         pose;
+    ompl::base::RealVectorStateSpace::StateType  position;
+    ompl::base::SO3StateSpace::StateType         rotation;
+    ompl::base::State                           *components[2];
   };
 
+  typedef bool (PoseComponent::*ComponentFunction)(StateType *full_state, unsigned int idx) const;
+
+  /// Call \e fn for every pose component of \e state; on components_pool_ if \e parallel is true and
+  /// the pool exists.  Components write disjoint parts of the state, so the result does not depend on
+  /// the order of the calls.  Returns true if all calls succeeded.
+  bool computeComponents(ComponentFunction fn, StateType *state, bool parallel) const;
+
+  void computeComponent(ComponentFunction fn, StateType *state, boost::atomic<bool> *failed, unsigned int idx) const;
+
   std::vector<PoseComponent> poses_;
   double jump_factor_;
+  double minimum_jump_;
+
+  /// Threads that compute the IK (and solver FK) of the pose components of a state concurrently;
+  /// only allocated when there are several components
+  std::shared_ptr<WorkerPool> components_pool_;
+
+  ReachabilityMapConstPtr reachability_map_;
 };
 
 }
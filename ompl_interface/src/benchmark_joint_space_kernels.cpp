@@ -0,0 +1,183 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+// Compare the distance, interpolation, equality and bounds checks of ModelBasedStateSpace, which use the
+// vectorized kernels of joint_space_kernels.h for groups of bounded single-variable joints, with the
+// generic path through the joint models of the JointModelGroup.  For groups with other joints, both
+// columns measure the generic path.
+//
+//   rosrun moveit_ompl_planning_interface moveit_ompl_benchmark_joint_space_kernels _group:=arm
+//     [_pairs:=1000] [_rounds:=1000]
+
+#include "moveit/ompl_interface/parameterization/joint_space/joint_model_state_space.h"
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <ompl/util/Time.h>
+#include <ros/ros.h>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+typedef ompl_interface::ModelBasedStateSpace::StateType StateType;
+
+const double* values(const ompl::base::State *state)
+{
+  return state->as<StateType>()->values;
+}
+
+double* values(ompl::base::State *state)
+{
+  return state->as<StateType>()->values;
+}
+
+// The equality test ModelBasedStateSpace used before the kernels
+bool equalValues(const double *a, const double *b, unsigned int n)
+{
+  for (unsigned int i = 0 ; i < n ; ++i)
+    if (fabs(a[i] - b[i]) > std::numeric_limits<double>::epsilon())
+      return false;
+  return true;
+}
+
+void report(const char *operation, double space_time, double group_time, double calls)
+{
+  ROS_INFO("%-16s %8.2f ns %8.2f ns %6.2fx", operation, space_time * 1e9 / calls, group_time * 1e9 / calls, group_time / space_time);
+}
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "benchmark_joint_space_kernels");
+  ros::NodeHandle nh("~");
+
+  std::string group;
+  int pairs, rounds;
+  nh.param("group", group, std::string());
+  nh.param("pairs", pairs, 1000);
+  nh.param("rounds", rounds, 1000);
+  if (group.empty() || pairs <= 0 || rounds <= 0)
+  {
+    ROS_ERROR("The group parameter is required; pairs and rounds must be positive");
+    return 1;
+  }
+
+  robot_model_loader::RobotModelLoader loader("robot_description");
+  if (!loader.getModel() || !loader.getModel()->hasJointModelGroup(group))
+    return 1;
+  ompl_interface::ModelBasedStateSpaceSpecification spec(loader.getModel(), group);
+  ompl_interface::JointModelStateSpace space(spec);
+  space.setup();
+  const robot_model::JointModelGroup *jmg = space.getJointModelGroup();
+  const unsigned int n = jmg->getVariableCount();
+
+  // random pairs of states; the second state of some pairs is a copy of the first, so equality is
+  // not always decided by the first value
+  ompl::base::StateSamplerPtr sampler = space.allocDefaultStateSampler();
+  std::vector<ompl::base::State*> from(pairs), to(pairs);
+  for (int i = 0 ; i < pairs ; ++i)
+  {
+    from[i] = space.allocState();
+    to[i] = space.allocState();
+    sampler->sampleUniform(from[i]);
+    if (i % 4 == 0)
+      space.copyState(to[i], from[i]);
+    else
+      sampler->sampleUniform(to[i]);
+  }
+  ompl::base::State *result = space.allocState();
+  const double calls = (double)pairs * rounds;
+
+  // the sums keep the compiler from dropping the loops, and show that both paths agree
+  double space_sum = 0.0, group_sum = 0.0;
+  ompl::time::point start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      space_sum += space.distance(from[i], to[i]);
+  double space_time = ompl::time::seconds(ompl::time::now() - start);
+  start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      group_sum += jmg->distance(values(from[i]), values(to[i]));
+  double group_time = ompl::time::seconds(ompl::time::now() - start);
+  ROS_INFO("group '%s', %u variables: state space / joint model group", group.c_str(), n);
+  report("distance", space_time, group_time, calls);
+  ROS_INFO("relative difference of the distances: %g", fabs(space_sum - group_sum) / std::max(group_sum, 1e-9));
+
+  start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      space.interpolate(from[i], to[i], 0.5, result);
+  space_time = ompl::time::seconds(ompl::time::now() - start);
+  start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      jmg->interpolate(values(from[i]), values(to[i]), 0.5, values(result));
+  group_time = ompl::time::seconds(ompl::time::now() - start);
+  report("interpolate", space_time, group_time, calls);
+
+  unsigned int space_count = 0, group_count = 0;
+  start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      space_count += space.equalStates(from[i], to[i]);
+  space_time = ompl::time::seconds(ompl::time::now() - start);
+  start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      group_count += equalValues(values(from[i]), values(to[i]), n);
+  group_time = ompl::time::seconds(ompl::time::now() - start);
+  report("equalStates", space_time, group_time, calls);
+
+  start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      space_count += space.satisfiesBounds(to[i]);
+  space_time = ompl::time::seconds(ompl::time::now() - start);
+  start = ompl::time::now();
+  for (int r = 0 ; r < rounds ; ++r)
+    for (int i = 0 ; i < pairs ; ++i)
+      group_count += jmg->satisfiesPositionBounds(values(to[i]), space.getJointsBounds(), std::numeric_limits<double>::epsilon());
+  group_time = ompl::time::seconds(ompl::time::now() - start);
+  report("satisfiesBounds", space_time, group_time, calls);
+  if (space_count != group_count)
+    ROS_WARN("The equality and bounds checks disagree: %u and %u states accepted", space_count, group_count);
+
+  space.freeState(result);
+  for (int i = 0 ; i < pairs ; ++i)
+  {
+    space.freeState(from[i]);
+    space.freeState(to[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+// Measure the per-sample cost of forward and inverse kinematics in PoseModelStateSpace, compared to
+// calling the kinematics solver of the group directly with newly built vectors and pose messages,
+// as the workspace parameterization did before it reused per-thread buffers.  FK of the state space
+// runs on the robot model when the frames of the solver are links of the model.
+//
+//   rosrun moveit_ompl_planning_interface moveit_ompl_benchmark_pose_model_kinematics _group:=arm
+//     [_samples:=10000]
+
+#include "moveit/ompl_interface/parameterization/work_space/pose_model_state_space.h"
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <ompl/util/Time.h>
+#include <ros/ros.h>
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "benchmark_pose_model_kinematics");
+  ros::NodeHandle nh("~");
+
+  std::string group;
+  int samples;
+  nh.param("group", group, std::string());
+  nh.param("samples", samples, 10000);
+  if (group.empty() || samples <= 0)
+  {
+    ROS_ERROR("The group parameter is required; samples must be positive");
+    return 1;
+  }
+
+  robot_model_loader::RobotModelLoader loader("robot_description");
+  if (!loader.getModel() || !loader.getModel()->hasJointModelGroup(group))
+    return 1;
+  const robot_model::JointModelGroup *jmg = loader.getModel()->getJointModelGroup(group);
+  const kinematics::KinematicsBaseConstPtr &solver = jmg->getSolverInstance();
+  if (!solver)
+  {
+    ROS_ERROR("Group '%s' has no kinematics solver", group.c_str());
+    return 1;
+  }
+
+  ompl_interface::ModelBasedStateSpaceSpecification spec(loader.getModel(), group);
+  ompl_interface::PoseModelStateSpace space(spec);
+  space.setup();
+  typedef ompl_interface::PoseModelStateSpace::StateType StateType;
+
+  // joint values drawn at random; the poses are computed by the measured calls
+  ompl::base::StateSamplerPtr sampler = space.allocDefaultStateSampler();
+  std::vector<ompl::base::State*> states(samples);
+  for (int i = 0 ; i < samples ; ++i)
+  {
+    states[i] = space.allocState();
+    sampler->sampleUniform(states[i]);
+  }
+
+  // the variables of the solver, in its order
+  const std::vector<std::string> &joints = solver->getJointNames();
+  std::vector<int> variables(joints.size());
+  for (std::size_t j = 0 ; j < joints.size() ; ++j)
+    variables[j] = jmg->getVariableGroupIndex(joints[j]);
+  std::vector<std::string> tips(1, solver->getTipFrame());
+
+  ompl::time::point start = ompl::time::now();
+  for (int i = 0 ; i < samples ; ++i)
+    space.computeStateFK(states[i]);
+  double space_fk = ompl::time::seconds(ompl::time::now() - start);
+
+  std::vector<geometry_msgs::Pose> poses(samples);
+  start = ompl::time::now();
+  for (int i = 0 ; i < samples ; ++i)
+  {
+    std::vector<double> values(variables.size());
+    for (std::size_t j = 0 ; j < variables.size() ; ++j)
+      values[j] = states[i]->as<StateType>()->values[variables[j]];
+    std::vector<geometry_msgs::Pose> fk;
+    if (solver->getPositionFK(tips, values, fk))
+      poses[i] = fk[0];
+  }
+  double solver_fk = ompl::time::seconds(ompl::time::now() - start);
+  ROS_INFO("FK: %.2f us per sample in the state space, %.2f us through the solver",
+           space_fk * 1e6 / samples, solver_fk * 1e6 / samples);
+
+  // IK of the poses just computed, seeded with the joint values they were computed from
+  space.clearIKFailures();
+  unsigned int space_solved = 0;
+  start = ompl::time::now();
+  for (int i = 0 ; i < samples ; ++i)
+  {
+    states[i]->as<StateType>()->setJointsComputed(false);
+    space_solved += space.computeStateIK(states[i]);
+  }
+  double space_ik = ompl::time::seconds(ompl::time::now() - start);
+
+  unsigned int solver_solved = 0;
+  start = ompl::time::now();
+  for (int i = 0 ; i < samples ; ++i)
+  {
+    std::vector<double> seed(variables.size()), solution;
+    for (std::size_t j = 0 ; j < variables.size() ; ++j)
+      seed[j] = states[i]->as<StateType>()->values[variables[j]];
+    moveit_msgs::MoveItErrorCodes error_code;
+    solver_solved += solver->getPositionIK(poses[i], seed, solution, error_code);
+  }
+  double solver_ik = ompl::time::seconds(ompl::time::now() - start);
+  ROS_INFO("IK: %.2f us per sample in the state space (%u solved), %.2f us through the solver (%u solved)",
+           space_ik * 1e6 / samples, space_solved, solver_ik * 1e6 / samples, solver_solved);
+
+  for (int i = 0 ; i < samples ; ++i)
+    space.freeState(states[i]);
+  return 0;
+}
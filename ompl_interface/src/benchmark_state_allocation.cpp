@@ -0,0 +1,239 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+// Measure the cost of allocating the states of a group from the state pool of ModelBasedStateSpace,
+// compared to allocating the StateType and the values separately on the heap, as the space did before.
+//
+//  - churn: a state is allocated and freed right away, as for samples that a planner rejects
+//  - tree: many states are allocated, scanned for the nearest one to a random state, and freed in
+//    random order, as when a tree is grown, queried and cleared
+//  - handoff: one thread allocates states and another one frees them, in rounds; the memory reserved
+//    by the pool must not grow after the first round
+//
+//   rosrun moveit_ompl_planning_interface moveit_ompl_benchmark_state_allocation _group:=arm
+//     [_states:=100000] [_rounds:=10]
+
+#include "moveit/ompl_interface/parameterization/joint_space/joint_model_state_space.h"
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <ompl/util/Time.h>
+#include <ros/ros.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <random>
+#include <limits>
+
+namespace
+{
+typedef ompl_interface::ModelBasedStateSpace::StateType StateType;
+
+// Allocation from the state pool of the space
+struct PoolAllocator
+{
+  PoolAllocator(const ompl_interface::ModelBasedStateSpace &space) : space_(space)
+  {
+  }
+
+  ompl::base::State* allocState() const
+  {
+    return space_.allocState();
+  }
+
+  void freeState(ompl::base::State *state) const
+  {
+    space_.freeState(state);
+  }
+
+  const ompl_interface::ModelBasedStateSpace &space_;
+};
+
+// Two heap allocations per state, as ModelBasedStateSpace did before the state pool
+struct HeapAllocator
+{
+  HeapAllocator(const ompl_interface::ModelBasedStateSpace &space) : space_(space)
+  {
+  }
+
+  ompl::base::State* allocState() const
+  {
+    StateType *state = new StateType();
+    state->values = new double[space_.getJointModelGroup()->getVariableCount()];
+    return state;
+  }
+
+  void freeState(ompl::base::State *state) const
+  {
+    delete[] state->as<StateType>()->values;
+    delete state->as<StateType>();
+  }
+
+  const ompl_interface::ModelBasedStateSpace &space_;
+};
+
+template<typename Allocator>
+double churn(const Allocator &allocator, int states)
+{
+  ompl::time::point start = ompl::time::now();
+  for (int i = 0 ; i < states ; ++i)
+    allocator.freeState(allocator.allocState());
+  return ompl::time::seconds(ompl::time::now() - start);
+}
+
+// Set \e times to the seconds spent allocating, scanning and freeing the states
+template<typename Allocator>
+void tree(const Allocator &allocator, const ompl_interface::ModelBasedStateSpace &space, int states, std::mt19937 &rng,
+          double times[3])
+{
+  ompl::base::StateSamplerPtr sampler = space.allocDefaultStateSampler();
+  std::vector<ompl::base::State*> tree(states);
+
+  ompl::time::point start = ompl::time::now();
+  for (int i = 0 ; i < states ; ++i)
+    tree[i] = allocator.allocState();
+  times[0] = ompl::time::seconds(ompl::time::now() - start);
+
+  for (int i = 0 ; i < states ; ++i)
+    sampler->sampleUniform(tree[i]);
+  ompl::base::State *query = allocator.allocState();
+  sampler->sampleUniform(query);
+  start = ompl::time::now();
+  double best = std::numeric_limits<double>::infinity();
+  for (int i = 0 ; i < states ; ++i)
+    best = std::min(best, space.distance(query, tree[i]));
+  times[1] = ompl::time::seconds(ompl::time::now() - start);
+  ROS_DEBUG("Distance to the nearest state: %f", best);
+  allocator.freeState(query);
+
+  std::shuffle(tree.begin(), tree.end(), rng);
+  start = ompl::time::now();
+  for (int i = 0 ; i < states ; ++i)
+    allocator.freeState(tree[i]);
+  times[2] = ompl::time::seconds(ompl::time::now() - start);
+}
+
+// The producer and the consumer are the same two threads in every round
+void allocateStates(const ompl_interface::ModelBasedStateSpace *space, std::vector<ompl::base::State*> *states,
+                    boost::barrier *barrier, int rounds)
+{
+  for (int r = 0 ; r < rounds ; ++r)
+  {
+    for (std::size_t i = 0 ; i < states->size() ; ++i)
+      (*states)[i] = space->allocState();
+    barrier->wait();  // the states are ready
+    barrier->wait();  // the states were freed
+  }
+}
+
+void freeStates(const ompl_interface::ModelBasedStateSpace *space, std::vector<ompl::base::State*> *states,
+                boost::barrier *barrier, int rounds)
+{
+  for (int r = 0 ; r < rounds ; ++r)
+  {
+    barrier->wait();
+    for (std::size_t i = 0 ; i < states->size() ; ++i)
+      space->freeState((*states)[i]);
+    barrier->wait();
+  }
+}
+
+std::size_t getPoolMemory(const ompl_interface::ModelBasedStateSpace &space)
+{
+  ompl_interface::MemoryUsageReport report;
+  space.getMemoryUsage(report);
+  return report["state_pool"].bytes;
+}
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "benchmark_state_allocation");
+  ros::NodeHandle nh("~");
+
+  std::string group;
+  int states, rounds;
+  nh.param("group", group, std::string());
+  nh.param("states", states, 100000);
+  nh.param("rounds", rounds, 10);
+  if (group.empty() || states <= 0 || rounds <= 0)
+  {
+    ROS_ERROR("The group parameter is required; states and rounds must be positive");
+    return 1;
+  }
+
+  robot_model_loader::RobotModelLoader loader("robot_description");
+  if (!loader.getModel() || !loader.getModel()->hasJointModelGroup(group))
+    return 1;
+  ompl_interface::ModelBasedStateSpaceSpecification spec(loader.getModel(), group);
+  ompl_interface::JointModelStateSpace space(spec);
+  space.setup();
+  PoolAllocator pool(space);
+  HeapAllocator heap(space);
+  std::mt19937 rng(0);
+
+  double pool_time = 0.0, heap_time = 0.0;
+  for (int r = 0 ; r < rounds ; ++r)
+  {
+    pool_time += churn(pool, states);
+    heap_time += churn(heap, states);
+  }
+  ROS_INFO("churn: %.1f ns per state from the pool, %.1f ns on the heap",
+           pool_time * 1e9 / ((double)states * rounds), heap_time * 1e9 / ((double)states * rounds));
+
+  double pool_times[3] = { 0.0, 0.0, 0.0 }, heap_times[3] = { 0.0, 0.0, 0.0 };
+  for (int r = 0 ; r < rounds ; ++r)
+  {
+    double t[3];
+    tree(pool, space, states, rng, t);
+    for (int k = 0 ; k < 3 ; ++k)
+      pool_times[k] += t[k] / rounds;
+    tree(heap, space, states, rng, t);
+    for (int k = 0 ; k < 3 ; ++k)
+      heap_times[k] += t[k] / rounds;
+  }
+  ROS_INFO("tree of %d states: allocate %.2f ms, scan %.2f ms, free %.2f ms from the pool", states,
+           pool_times[0] * 1e3, pool_times[1] * 1e3, pool_times[2] * 1e3);
+  ROS_INFO("tree of %d states: allocate %.2f ms, scan %.2f ms, free %.2f ms on the heap", states,
+           heap_times[0] * 1e3, heap_times[1] * 1e3, heap_times[2] * 1e3);
+
+  std::vector<ompl::base::State*> handoff(states);
+  boost::barrier barrier(2);
+  std::size_t before = getPoolMemory(space);
+  boost::thread producer(boost::bind(&allocateStates, &space, &handoff, &barrier, rounds));
+  boost::thread consumer(boost::bind(&freeStates, &space, &handoff, &barrier, rounds));
+  producer.join();
+  consumer.join();
+  ROS_INFO("handoff of %d states over %d rounds: the pool grew from %lu to %lu bytes", states, rounds,
+           (unsigned long)before, (unsigned long)getPoolMemory(space));
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+// Measure how state validity checking scales with the number of threads when every check gets its
+// RobotState from TSStateStorage, compared to a storage that locks a map on every lookup.  Each check
+// takes the thread's state, sets random joint values, updates the transforms and checks collisions
+// of the robot with itself in an empty scene.
+//
+//   rosrun moveit_ompl_planning_interface moveit_ompl_benchmark_state_storage _group:=arm
+//     [_threads:=8] [_checks:=20000]
+
+#include "moveit/ompl_interface/detail/threadsafe_state_storage.h"
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <random_numbers/random_numbers.h>
+#include <ompl/util/Time.h>
+#include <ros/ros.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <map>
+
+namespace
+{
+// The storage TSStateStorage replaced: a map from thread id to state, behind a lock
+class LockedStateStorage
+{
+public:
+
+  LockedStateStorage(const robot_model::RobotModelPtr &model) : start_state_(model)
+  {
+    start_state_.setToDefaultValues();
+  }
+
+  ~LockedStateStorage()
+  {
+    for (std::map<boost::thread::id, robot_state::RobotState*>::iterator it = states_.begin() ; it != states_.end() ; ++it)
+      delete it->second;
+  }
+
+  robot_state::RobotState* getStateStorage() const
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    robot_state::RobotState *&st = states_[boost::this_thread::get_id()];
+    if (!st)
+      st = new robot_state::RobotState(start_state_);
+    return st;
+  }
+
+private:
+
+  robot_state::RobotState                                      start_state_;
+  mutable std::map<boost::thread::id, robot_state::RobotState*> states_;
+  mutable boost::mutex                                          lock_;
+};
+
+template<typename Storage>
+void check(const Storage *storage, const planning_scene::PlanningScene *scene, const std::string *group, int checks)
+{
+  const robot_model::JointModelGroup *jmg = scene->getRobotModel()->getJointModelGroup(*group);
+  random_numbers::RandomNumberGenerator rng;
+  for (int i = 0 ; i < checks ; ++i)
+  {
+    robot_state::RobotState *state = storage->getStateStorage();
+    state->setToRandomPositions(jmg, rng);
+    state->update();
+    scene->isStateColliding(*state, *group);
+  }
+}
+
+// Run \e threads threads of \e checks checks each; return the checks per second
+template<typename Storage>
+double run(const Storage &storage, const planning_scene::PlanningScene &scene, const std::string &group, unsigned int threads, int checks)
+{
+  ompl::time::point start = ompl::time::now();
+  boost::thread_group workers;
+  for (unsigned int i = 0 ; i < threads ; ++i)
+    workers.create_thread(boost::bind(&check<Storage>, &storage, &scene, &group, checks));
+  workers.join_all();
+  return (double)threads * checks / ompl::time::seconds(ompl::time::now() - start);
+}
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "benchmark_state_storage");
+  ros::NodeHandle nh("~");
+
+  std::string group;
+  int threads, checks;
+  nh.param("group", group, std::string());
+  nh.param("threads", threads, (int)std::max(1u, boost::thread::hardware_concurrency()));
+  nh.param("checks", checks, 20000);
+  if (group.empty() || threads <= 0 || checks <= 0)
+  {
+    ROS_ERROR("The group parameter is required; threads and checks must be positive");
+    return 1;
+  }
+
+  robot_model_loader::RobotModelLoader loader("robot_description");
+  if (!loader.getModel() || !loader.getModel()->hasJointModelGroup(group))
+    return 1;
+  planning_scene::PlanningScene scene(loader.getModel());
+
+  ROS_INFO("threads  TSStateStorage (checks/s, speedup)  locked map (checks/s, speedup)");
+  double ts_base = 0.0, locked_base = 0.0;
+  for (int t = 1 ; t <= threads ; ++t)
+  {
+    // fresh storages, so the first lookup of every thread is part of the measurement
+    ompl_interface::TSStateStorage ts_storage(loader.getModel());
+    LockedStateStorage locked_storage(loader.getModel());
+    double ts_rate = run(ts_storage, scene, group, t, checks);
+    double locked_rate = run(locked_storage, scene, group, t, checks);
+    if (t == 1)
+    {
+      ts_base = ts_rate;
+      locked_base = locked_rate;
+    }
+    ROS_INFO("%7d  %12.0f %6.2fx  %12.0f %6.2fx", t, ts_rate, ts_rate / ts_base, locked_rate, locked_rate / locked_base);
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+// Build the reachability map of a group offline and save it to disk.  Set the path of the file as the
+// reachability_map parameter of the group for the planning context manager to load it.
+//
+//   rosrun moveit_ompl_planning_interface moveit_ompl_build_reachability_map _group:=arm _output:=arm.rmap
+//     [_resolution:=0.05] [_samples:=1000000] [_ik_checks:=10000]
+
+#include "moveit/ompl_interface/detail/reachability_map.h"
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <ros/ros.h>
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "build_reachability_map");
+  ros::NodeHandle nh("~");
+
+  std::string group, output;
+  double resolution;
+  int samples, ik_checks;
+  nh.param("group", group, std::string());
+  nh.param("output", output, std::string());
+  nh.param("resolution", resolution, 0.05);
+  nh.param("samples", samples, 1000000);
+  nh.param("ik_checks", ik_checks, 10000);
+  if (group.empty() || output.empty() || samples <= 0 || ik_checks < 0)
+  {
+    ROS_ERROR("The group and output parameters are required; samples must be positive");
+    return 1;
+  }
+
+  robot_model_loader::RobotModelLoader loader("robot_description");
+  if (!loader.getModel())
+    return 1;
+
+  ompl_interface::ReachabilityMap map;
+  if (!map.build(loader.getModel(), group, resolution, samples, ik_checks) || !map.save(output))
+    return 1;
+  ROS_INFO("Saved the reachability map of '%s' to '%s'", group.c_str(), output.c_str());
+  return 0;
+}
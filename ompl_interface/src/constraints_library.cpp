@@ -84,16 +84,26 @@ class ConstraintApproximationStateSampler : public ompl::base::StateSampler
 {
 public:
 
-  ConstraintApproximationStateSampler(const ompl::base::StateSpace *space, const ConstraintApproximationStateStorage *state_storage, std::size_t milestones) :
-    ompl::base::StateSampler(space), state_storage_(state_storage)
+  ConstraintApproximationStateSampler(const ompl::base::StateSpace *space, const ConstraintApproximation *approx, std::size_t milestones) :
+    ompl::base::StateSampler(space), approx_(approx)
   {
     max_index_ = milestones - 1;
     inv_dim_ = space->getDimension() > 0 ? 1.0 / (double)space->getDimension() : 1.0;
+    scratch_ = approx_->hasCompactStates() ? space->allocState() : NULL;
+  }
+
+  virtual ~ConstraintApproximationStateSampler()
+  {
+    if (scratch_)
+      space_->freeState(scratch_);
   }
 
   virtual void sampleUniform(ompl::base::State *state)
   {
-    space_->copyState(state, state_storage_->getState(rng_.uniformInt(0, max_index_)));
+    if (scratch_)
+      approx_->getState(rng_.uniformInt(0, max_index_), state);
+    else
+      space_->copyState(state, approx_->getState(rng_.uniformInt(0, max_index_), NULL));
   }
 
   virtual void sampleUniformNear(ompl::base::State *state, const ompl::base::State *near, const double distance)
@@ -103,7 +113,7 @@ public:
 
     if (tag >= 0)
     {
-      const ConstrainedStateMetadata &md = state_storage_->getMetadata(tag);
+      const ConstrainedStateMetadata &md = approx_->getMetadata(tag);
       if (!md.first.empty())
       {
         std::size_t matt = md.first.size() / 3;
@@ -121,15 +131,16 @@ public:
     if (index < 0)
       index = rng_.uniformInt(0, max_index_);
 
-    double dist = space_->distance(near, state_storage_->getState(index));
+    const ompl::base::State *stored = approx_->getState(index, scratch_);
+    double dist = space_->distance(near, stored);
 
     if (dist > distance)
     {
       double d = pow(rng_.uniform01(), inv_dim_) * distance;
-      space_->interpolate(near, state_storage_->getState(index), d / dist, state);
+      space_->interpolate(near, stored, d / dist, state);
     }
     else
-      space_->copyState(state, state_storage_->getState(index));
+      space_->copyState(state, stored);
   }
 
   virtual void sampleGaussian(ompl::base::State *state, const ompl::base::State *mean, const double stdDev)
@@ -139,14 +150,17 @@ public:
 
 protected:
 
-  /** \brief The states to sample from */
-  const ConstraintApproximationStateStorage *state_storage_;
+  /** \brief The approximation holding the states to sample from */
+  const ConstraintApproximation *approx_;
+  /** \brief Decompressed state, when the states are kept compact */
+  ompl::base::State *scratch_;
   std::set<std::size_t> dirty_;
   unsigned int max_index_;
   double inv_dim_;
 };
 
-bool interpolateUsingStoredStates(const ConstraintApproximationStateStorage *state_storage, const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state)
+bool interpolateUsingStoredStates(const ConstraintApproximation *approx, const ompl::base::StateSpacePtr &space, const ompl::base::State *from,
+                                  const ompl::base::State *to, const double t, ompl::base::State *state)
 {
   int tag_from = from->as<ModelBasedStateSpace::StateType>()->tag;
   int tag_to = to->as<ModelBasedStateSpace::StateType>()->tag;
@@ -155,10 +169,10 @@ bool interpolateUsingStoredStates(const ConstraintApproximationStateStorage *sta
     return false;
 
   if (tag_from == tag_to)
-    state_storage->getStateSpace()->copyState(state, to);
+    space->copyState(state, to);
   else
   {
-    const ConstrainedStateMetadata &md = state_storage->getMetadata(tag_from);
+    const ConstrainedStateMetadata &md = approx->getMetadata(tag_from);
 
     std::map<std::size_t, std::pair<std::size_t, std::size_t> >::const_iterator it = md.second.find(tag_to);
     if (it == md.second.end())
@@ -167,14 +181,19 @@ bool interpolateUsingStoredStates(const ConstraintApproximationStateStorage *sta
     std::size_t index = (std::size_t)((istates.second - istates.first + 2) * t + 0.5);
 
     if (index == 0)
-      state_storage->getStateSpace()->copyState(state, from);
+      space->copyState(state, from);
     else
     {
       --index;
       if (index >= istates.second - istates.first)
-        state_storage->getStateSpace()->copyState(state, to);
+        space->copyState(state, to);
       else
-        state_storage->getStateSpace()->copyState(state, state_storage->getState(istates.first + index));
+      {
+        // compact states are decompressed directly into the result
+        const ompl::base::State *stored = approx->getState(istates.first + index, state);
+        if (stored != state)
+          space->copyState(state, stored);
+      }
     }
   }
   return true;
@@ -182,20 +201,20 @@ bool interpolateUsingStoredStates(const ConstraintApproximationStateStorage *sta
 
 ompl_interface::InterpolationFunction ompl_interface::ConstraintApproximation::getInterpolationFunction() const
 {
-  if (explicit_motions_ && milestones_ > 0 && milestones_ < state_storage_->size())
-    return boost::bind(&interpolateUsingStoredStates, state_storage_, _1, _2, _3, _4);
+  if (explicit_motions_ && milestones_ > 0 && milestones_ < getStateCount())
+    return boost::bind(&interpolateUsingStoredStates, this, space_, _1, _2, _3, _4);
   return InterpolationFunction();
 }
 
 ompl::base::StateSamplerPtr allocConstraintApproximationStateSampler(const ompl::base::StateSpace *space, const std::vector<int> &expected_signature,
-                                                                     const ConstraintApproximationStateStorage *state_storage, std::size_t milestones)
+                                                                     const ConstraintApproximation *approx, std::size_t milestones)
 {
   std::vector<int> sig;
   space->computeSignature(sig);
   if (sig != expected_signature)
     return ompl::base::StateSamplerPtr();
   else
-    return ompl::base::StateSamplerPtr(new ConstraintApproximationStateSampler(space, state_storage, milestones));
+    return ompl::base::StateSamplerPtr(new ConstraintApproximationStateSampler(space, approx, milestones));
 }
 
 }
@@ -207,16 +226,77 @@ ompl_interface::ConstraintApproximation::ConstraintApproximation(const std::stri
   ompldb_filename_(filename), state_storage_ptr_(storage), milestones_(milestones)
 {
   state_storage_ = static_cast<ConstraintApproximationStateStorage*>(state_storage_ptr_.get());
-  state_storage_->getStateSpace()->computeSignature(space_signature_);
+  space_ = state_storage_->getStateSpace();
+  space_->computeSignature(space_signature_);
   if (milestones_ == 0)
     milestones_ = state_storage_->size();
 }
 
+void ompl_interface::ConstraintApproximation::compactStates(CompactStateStorage::Precision precision)
+{
+  if (!state_storage_)
+    return;
+
+  CompactStateStoragePtr compact(new CompactStateStorage(std::static_pointer_cast<ModelBasedStateSpace>(space_), precision));
+  std::size_t count = state_storage_->size();
+  compact->reserve(count);
+  compact_metadata_.resize(count);
+  for (std::size_t i = 0 ; i < count ; ++i)
+  {
+    compact->addState(state_storage_->getState(i));
+    compact_metadata_[i].swap(state_storage_->getMetadata(i));
+  }
+  compact_storage_ = compact;
+
+  // the full states are no longer needed
+  state_storage_ = NULL;
+  state_storage_ptr_.reset();
+  ROS_DEBUG("Constraint approximation '%s' keeps %lu states in %lu bytes", getName().c_str(), count, compact_storage_->getMemoryUsage());
+}
+
+std::size_t ompl_interface::ConstraintApproximation::getStateCount() const
+{
+  return state_storage_ ? state_storage_->size() : compact_storage_->size();
+}
+
+const ompl_interface::ConstrainedStateMetadata& ompl_interface::ConstraintApproximation::getMetadata(std::size_t index) const
+{
+  return state_storage_ ? state_storage_->getMetadata(index) : compact_metadata_[index];
+}
+
+const ompl::base::State* ompl_interface::ConstraintApproximation::getState(std::size_t index, ompl::base::State *scratch) const
+{
+  if (state_storage_)
+    return state_storage_->getState(index);
+  compact_storage_->getState(index, scratch);
+  return scratch;
+}
+
+void ompl_interface::ConstraintApproximation::storeStates(const std::string &filename) const
+{
+  if (state_storage_)
+  {
+    state_storage_->store(filename.c_str());
+    return;
+  }
+
+  // expand the compact states into a temporary full precision storage
+  ConstraintApproximationStateStorage cass(space_);
+  ompl::base::State *state = space_->allocState();
+  for (std::size_t i = 0 ; i < compact_storage_->size() ; ++i)
+  {
+    compact_storage_->getState(i, state);
+    cass.addState(state, compact_metadata_[i]);
+  }
+  space_->freeState(state);
+  cass.store(filename.c_str());
+}
+
 ompl::base::StateSamplerAllocator ompl_interface::ConstraintApproximation::getStateSamplerAllocator(const moveit_msgs::Constraints &msg) const
 {
-  if (state_storage_->size() == 0)
+  if (getStateCount() == 0)
     return ompl::base::StateSamplerAllocator();
-  return boost::bind(&allocConstraintApproximationStateSampler, _1, space_signature_, state_storage_, milestones_);
+  return boost::bind(&allocConstraintApproximationStateSampler, _1, space_signature_, this, milestones_);
 }
 /*
 void ompl_interface::ConstraintApproximation::visualizeDistribution(const std::string &link_name, unsigned int count, visualization_msgs::MarkerArray &arr) const
@@ -298,14 +378,17 @@ void ompl_interface::ConstraintsLibrary::loadConstraintApproximations(const std:
     cass->load((path + "/" + filename).c_str());
     ConstraintApproximationPtr cap(new ConstraintApproximation(group, state_space_parameterization, explicit_motions, msg, filename,
                                                                ompl::base::StateStoragePtr(cass), milestones));
+    std::size_t sum = 0;
+    std::size_t state_count = cass->size();
+    for (std::size_t i = 0 ; i < state_count ; ++i)
+      sum += cass->getMetadata(i).first.size();
+    if (compact_states_)
+      cap->compactStates(compact_precision_);
     if (constraint_approximations_.find(cap->getName()) != constraint_approximations_.end())
       ROS_WARN("Overwriting constraint approximation named '%s'", cap->getName().c_str());
     constraint_approximations_[cap->getName()] = cap;
-    std::size_t sum = 0;
-    for (std::size_t i = 0 ; i < cass->size() ; ++i)
-      sum += cass->getMetadata(i).first.size();
     ROS_INFO("Loaded %lu states (%lu milestones) and %lu connections (%0.1lf per state) for constraint named '%s'%s",
-              cass->size(), cap->getMilestoneCount(), sum, (double)sum / (double)cap->getMilestoneCount(), msg.name.c_str(), explicit_motions ? ". Explicit motions included." : "");
+              state_count, cap->getMilestoneCount(), sum, (double)sum / (double)cap->getMilestoneCount(), msg.name.c_str(), explicit_motions ? ". Explicit motions included." : "");
 
   }
   ROS_INFO("Done loading constrained space approximations.");
@@ -334,8 +417,7 @@ void ompl_interface::ConstraintsLibrary::saveConstraintApproximations(const std:
       msgToHex(it->second->getConstraintsMsg(), serialization);
       fout << serialization << std::endl;
       fout << it->second->getFilename() << std::endl;
-      if (it->second->getStateStorage())
-        it->second->getStateStorage()->store((path + "/" + it->second->getFilename()).c_str());
+      it->second->storeStates(path + "/" + it->second->getFilename());
     }
   else
     ROS_ERROR("Unable to save constraint approximation to '%s'", path.c_str());
@@ -396,6 +478,8 @@ ompl_interface::ConstraintsLibrary::addConstraintApproximation(const moveit_msgs
     ConstraintApproximationPtr ca(new ConstraintApproximation(group, options.state_space_parameterization, options.explicit_motions, constr_hard, group + "_" +
                                                               boost::posix_time::to_iso_extended_string(boost::posix_time::microsec_clock::universal_time()) + ".ompldb",
                                                               ss, res.milestones));
+    if (options.compact_states)
+      ca->compactStates(options.compact_precision);
     if (constraint_approximations_.find(ca->getName()) != constraint_approximations_.end())
       ROS_WARN("Overwriting constraint approximation named '%s'", ca->getName().c_str());
     constraint_approximations_[ca->getName()] = ca;
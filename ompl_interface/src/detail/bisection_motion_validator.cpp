@@ -0,0 +1,346 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/bisection_motion_validator.h"
+#include "moveit/ompl_interface/parameterization/model_based_state_space.h"
+#include <boost/functional/hash.hpp>
+#include <cstring>
+
+namespace
+{
+// FNV-1a over the raw bytes of the joint values
+std::size_t hashValues(const double *values, unsigned int count)
+{
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(values);
+  const std::size_t n = count * sizeof(double);
+  boost::uint64_t h = 14695981039346656037ULL;
+  for (std::size_t i = 0 ; i < n ; ++i)
+  {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+  return static_cast<std::size_t>(h);
+}
+}
+
+std::size_t ompl_interface::BisectionMotionValidator::SegmentKeyHash::operator()(const SegmentKey &k) const
+{
+  std::size_t seed = k.first;
+  boost::hash_combine(seed, k.second);
+  return seed;
+}
+
+ompl_interface::BisectionMotionValidator::BisectionMotionValidator(const ompl::base::SpaceInformationPtr &si, std::size_t max_cache_size)
+  : ompl::base::MotionValidator(si)
+  , state_space_(si->getStateSpace().get())
+  , variable_count_(si->getStateSpace()->as<ModelBasedStateSpace>()->getJointModelGroup()->getVariableCount())
+  , sequential_interpolation_(si->getStateSpace()->as<ModelBasedStateSpace>()->hasSequentialInterpolation())
+  , max_cache_size_(max_cache_size)
+{
+  cache_size_ = 0;
+  cache_hits_ = 0;
+  saved_checks_ = 0;
+  performed_checks_ = 0;
+}
+
+void ompl_interface::BisectionMotionValidator::clearCache()
+{
+  for (unsigned int i = 0 ; i < CACHE_SHARDS ; ++i)
+  {
+    boost::mutex::scoped_lock slock(shards_[i].lock);
+    shards_[i].segments.clear();
+  }
+  cache_size_ = 0;
+  cache_hits_ = 0;
+  saved_checks_ = 0;
+  performed_checks_ = 0;
+}
+
+std::size_t ompl_interface::BisectionMotionValidator::getCacheHits() const
+{
+  return cache_hits_;
+}
+
+std::size_t ompl_interface::BisectionMotionValidator::getSavedStateChecks() const
+{
+  return saved_checks_;
+}
+
+std::size_t ompl_interface::BisectionMotionValidator::getPerformedStateChecks() const
+{
+  return performed_checks_;
+}
+
+std::size_t ompl_interface::BisectionMotionValidator::getCacheSize() const
+{
+  return cache_size_;
+}
+
+std::size_t ompl_interface::BisectionMotionValidator::getCacheMemoryUsage() const
+{
+  // every entry is a node holding the value and a link to the next node, and the endpoint values
+  std::size_t bytes = 0;
+  for (unsigned int i = 0 ; i < CACHE_SHARDS ; ++i)
+  {
+    boost::mutex::scoped_lock slock(shards_[i].lock);
+    bytes += shards_[i].segments.size() * (sizeof(SegmentMap::value_type) + sizeof(void*) + 2 * variable_count_ * sizeof(double)) +
+      shards_[i].segments.bucket_count() * sizeof(void*);
+  }
+  return bytes;
+}
+
+ompl_interface::BisectionMotionValidator::CacheShard& ompl_interface::BisectionMotionValidator::getShard(const SegmentKey &key) const
+{
+  // the maps use the low bits of the same hash for their buckets; take the shard from the high bits
+  std::size_t h = SegmentKeyHash()(key);
+  return shards_[(h >> (sizeof(std::size_t) * 4)) % CACHE_SHARDS];
+}
+
+std::size_t ompl_interface::BisectionMotionValidator::fingerprint(const ompl::base::State *state) const
+{
+  return hashValues(state->as<ModelBasedStateSpace::StateType>()->values, variable_count_);
+}
+
+void ompl_interface::BisectionMotionValidator::makeKey(const ompl::base::State *s1, const ompl::base::State *s2, SegmentKey &key) const
+{
+  key.first = fingerprint(s1);
+  key.second = fingerprint(s2);
+}
+
+bool ompl_interface::BisectionMotionValidator::lookup(const SegmentKey &key, const ompl::base::State *s1, const ompl::base::State *s2,
+                                                      SegmentResult &result) const
+{
+  const std::size_t bytes = variable_count_ * sizeof(double);
+  CacheShard &shard = getShard(key);
+  boost::mutex::scoped_lock slock(shard.lock);
+  SegmentMap::const_iterator it = shard.segments.find(key);
+  if (it == shard.segments.end())
+    return false;
+  // the key is a hash; make sure the entry is for these endpoints
+  const std::vector<double> &endpoints = it->second.endpoints;
+  if (memcmp(&endpoints[0], s1->as<ModelBasedStateSpace::StateType>()->values, bytes) != 0 ||
+      memcmp(&endpoints[variable_count_], s2->as<ModelBasedStateSpace::StateType>()->values, bytes) != 0)
+    return false;
+  result.valid = it->second.valid;
+  result.segments = it->second.segments;
+  result.last_valid = it->second.last_valid;
+  return true;
+}
+
+void ompl_interface::BisectionMotionValidator::store(const SegmentKey &key, const ompl::base::State *s1, const ompl::base::State *s2,
+                                                     SegmentResult &result) const
+{
+  // keep memory bounded: when the cache is full, the segments already in it are kept and new ones are
+  // not stored. The cache only lives for one solve, and segments checked early (near the start, the
+  // goals and the first solutions) are the ones validated again.
+  if (cache_size_ >= max_cache_size_)
+    return;
+
+  const double *v1 = s1->as<ModelBasedStateSpace::StateType>()->values;
+  const double *v2 = s2->as<ModelBasedStateSpace::StateType>()->values;
+  result.endpoints.resize(2 * variable_count_);
+  std::copy(v1, v1 + variable_count_, result.endpoints.begin());
+  std::copy(v2, v2 + variable_count_, result.endpoints.begin() + variable_count_);
+
+  CacheShard &shard = getShard(key);
+  boost::mutex::scoped_lock slock(shard.lock);
+  std::pair<SegmentMap::iterator, bool> inserted = shard.segments.insert(std::make_pair(key, result));
+  if (inserted.second)
+    ++cache_size_;
+  else
+    inserted.first->second = result;
+}
+
+void ompl_interface::BisectionMotionValidator::recordChecks(std::size_t performed, std::size_t saved, bool hit) const
+{
+  if (performed)
+    performed_checks_ += performed;
+  if (saved)
+    saved_checks_ += saved;
+  if (hit)
+    ++cache_hits_;
+}
+
+const ompl::base::State* ompl_interface::BisectionMotionValidator::getIntermediateState(const ompl::base::State *s1, const ompl::base::State *s2,
+                                                                                    int j, int nd, ompl::base::State *test,
+                                                                                    const std::vector<ompl::base::State*> &segment) const
+{
+  if (!segment.empty())
+    return segment[j - 1];
+  state_space_->interpolate(s1, s2, (double)j / (double)nd, test);
+  return test;
+}
+
+bool ompl_interface::BisectionMotionValidator::isIntermediateValid(const ompl::base::State *state) const
+{
+  const ModelBasedStateSpace::StateType *mstate = state->as<ModelBasedStateSpace::StateType>();
+  if (mstate->isValidityKnown() && !mstate->isMarkedValid())
+    return false;
+  return si_->isValid(state);
+}
+
+bool ompl_interface::BisectionMotionValidator::checkSegment(const ompl::base::State *s1, const ompl::base::State *s2, int nd,
+                                                            int *first_invalid, std::size_t &performed) const
+{
+  // the endpoint is the most likely state to be invalid; check it first
+  ++performed;
+  int invalid = si_->isValid(s2) ? -1 : nd;
+  if (invalid > 0 && !first_invalid)
+    return false;
+
+  if (nd > 1)
+  {
+    // when the first invalid state is needed, remember which states are already known to be valid
+    std::vector<char> checked;
+    if (first_invalid)
+      checked.resize(nd, 0);
+
+    ompl::base::State *test = si_->allocState();
+
+    std::vector<ompl::base::State*> segment;
+    if (sequential_interpolation_)
+    {
+      segment.resize(nd - 1);
+      si_->allocStates(segment);
+      state_space_->as<ModelBasedStateSpace>()->interpolateSegment(s1, s2, nd, &segment[0]);
+    }
+
+    // visit indices 1..nd-1 coarse to fine: every index has a unique largest power of two divisor,
+    // so each stride visits the odd multiples of itself and every index is visited exactly once
+    int found = -1;
+    int stride = 1;
+    while (stride * 2 < nd)
+      stride *= 2;
+    for ( ; stride >= 1 && found < 0 ; stride /= 2)
+      for (int j = stride ; j < nd ; j += 2 * stride)
+      {
+        ++performed;
+        if (!isIntermediateValid(getIntermediateState(s1, s2, j, nd, test, segment)))
+        {
+          found = j;
+          break;
+        }
+        if (first_invalid)
+          checked[j] = 1;
+      }
+    if (found > 0)
+      invalid = found;
+
+    // an invalid state was found; the first invalid state along the segment lies before it
+    if (first_invalid && invalid > 0)
+      for (int j = 1 ; j < invalid ; ++j)
+      {
+        if (checked[j])
+          continue;
+        ++performed;
+        if (!isIntermediateValid(getIntermediateState(s1, s2, j, nd, test, segment)))
+        {
+          invalid = j;
+          break;
+        }
+      }
+
+    si_->freeState(test);
+    if (!segment.empty())
+      si_->freeStates(segment);
+  }
+
+  if (first_invalid)
+    *first_invalid = invalid > 0 ? invalid : 0;
+  return invalid < 0;
+}
+
+bool ompl_interface::BisectionMotionValidator::checkMotion(const ompl::base::State *s1, const ompl::base::State *s2) const
+{
+  SegmentKey key;
+  makeKey(s1, s2, key);
+
+  SegmentResult result;
+  if (lookup(key, s1, s2, result))
+  {
+    recordChecks(0, result.segments, true);
+  }
+  else
+  {
+    std::size_t performed = 0;
+    int nd = state_space_->validSegmentCount(s1, s2);
+    result.valid = checkSegment(s1, s2, nd, NULL, performed);
+    result.segments = nd;
+    // the first invalid state is not searched for here; an invalid entry cannot answer the other overload
+    result.last_valid = -1.0;
+    store(key, s1, s2, result);
+    recordChecks(performed, 0, false);
+  }
+
+  if (result.valid)
+    valid_++;
+  else
+    invalid_++;
+  return result.valid;
+}
+
+bool ompl_interface::BisectionMotionValidator::checkMotion(const ompl::base::State *s1, const ompl::base::State *s2,
+                                                           std::pair<ompl::base::State*, double> &last_valid) const
+{
+  SegmentKey key;
+  makeKey(s1, s2, key);
+
+  SegmentResult result;
+  bool hit = lookup(key, s1, s2, result) && (result.valid || result.last_valid >= 0.0);
+  if (hit)
+    recordChecks(0, result.segments, true);
+  else
+  {
+    std::size_t performed = 0;
+    int nd = state_space_->validSegmentCount(s1, s2);
+    int first_invalid = 0;
+    result.valid = checkSegment(s1, s2, nd, &first_invalid, performed);
+    result.segments = nd;
+    result.last_valid = result.valid ? 0.0 : (double)(first_invalid - 1) / (double)nd;
+    store(key, s1, s2, result);
+    recordChecks(performed, 0, false);
+  }
+
+  if (result.valid)
+  {
+    valid_++;
+    return true;
+  }
+
+  last_valid.second = result.last_valid;
+  if (last_valid.first)
+    state_space_->interpolate(s1, s2, last_valid.second, last_valid.first);
+  invalid_++;
+  return false;
+}
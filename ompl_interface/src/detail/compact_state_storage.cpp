@@ -0,0 +1,172 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/compact_state_storage.h"
+#include <ros/console.h>
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ompl_interface::CompactStateStorage::CompactStateStorage(const ModelBasedStateSpacePtr &space, Precision precision)
+  : space_(space)
+  , precision_(precision)
+  , variable_count_(space->getJointModelGroup()->getVariableCount())
+{
+  if (precision_ != UINT16)
+    return;
+
+  // the quantization range of each variable is taken from the bounds of the space
+  const robot_model::JointBoundsVector &bounds = space_->getJointsBounds();
+  const std::vector<const robot_model::JointModel*> &joints = space_->getJointModelGroup()->getActiveJointModels();
+  const double pi = boost::math::constants::pi<double>();
+  lower_.resize(variable_count_, 0.0);
+  step_.resize(variable_count_, 0.0);
+  wrap_.resize(variable_count_, false);
+  for (std::size_t i = 0 ; i < joints.size() && i < bounds.size() ; ++i)
+  {
+    int index = space_->getJointModelGroup()->getVariableGroupIndex(joints[i]->getVariableNames()[0]);
+    for (std::size_t j = 0 ; j < bounds[i]->size() ; ++j)
+    {
+      // angles without bounds (continuous revolute joints, the orientation of planar joints) cover a fixed range
+      if ((joints[i]->getType() == robot_model::JointModel::REVOLUTE &&
+           static_cast<const robot_model::RevoluteJointModel*>(joints[i])->isContinuous()) ||
+          (joints[i]->getType() == robot_model::JointModel::PLANAR && j == 2))
+      {
+        wrap_[index + j] = true;
+        lower_[index + j] = -pi;
+        step_[index + j] = 2.0 * pi / std::numeric_limits<boost::uint16_t>::max();
+        continue;
+      }
+
+      const robot_model::VariableBounds &b = (*bounds[i])[j];
+      double range = b.max_position_ - b.min_position_;
+      if (!b.position_bounded_ || !(range >= 0.0) || range == std::numeric_limits<double>::infinity())
+      {
+        ROS_WARN("Variable '%s' has no finite bounds; storing states of '%s' as float32 instead of uint16",
+                 joints[i]->getVariableNames()[j].c_str(), space_->getName().c_str());
+        precision_ = FLOAT32;
+        lower_.clear();
+        step_.clear();
+        wrap_.clear();
+        return;
+      }
+      lower_[index + j] = b.min_position_;
+      step_[index + j] = range / std::numeric_limits<boost::uint16_t>::max();
+    }
+  }
+}
+
+void ompl_interface::CompactStateStorage::addState(const ompl::base::State *state)
+{
+  const double *values = state->as<ModelBasedStateSpace::StateType>()->values;
+  tags_.push_back(state->as<ModelBasedStateSpace::StateType>()->tag);
+  if (precision_ == FLOAT32)
+    float_values_.insert(float_values_.end(), values, values + variable_count_);
+  else
+  {
+    const double max_level = std::numeric_limits<boost::uint16_t>::max();
+    const double pi = boost::math::constants::pi<double>();
+    for (unsigned int i = 0 ; i < variable_count_ ; ++i)
+    {
+      double v = values[i];
+      if (wrap_[i] && (v < -pi || v > pi))
+        v -= 2.0 * pi * floor((v + pi) / (2.0 * pi));
+      double level = step_[i] > 0.0 ? (v - lower_[i]) / step_[i] : 0.0;
+      quantized_values_.push_back(static_cast<boost::uint16_t>(std::min(max_level, std::max(0.0, level)) + 0.5));
+    }
+  }
+}
+
+void ompl_interface::CompactStateStorage::getState(std::size_t index, ompl::base::State *state) const
+{
+  ModelBasedStateSpace::StateType *s = state->as<ModelBasedStateSpace::StateType>();
+  s->clearKnownInformation();
+  s->tag = tags_[index];
+  if (precision_ == FLOAT32)
+  {
+    const float *v = &float_values_[index * variable_count_];
+    for (unsigned int i = 0 ; i < variable_count_ ; ++i)
+      s->values[i] = v[i];
+  }
+  else
+  {
+    const boost::uint16_t *v = &quantized_values_[index * variable_count_];
+    for (unsigned int i = 0 ; i < variable_count_ ; ++i)
+      s->values[i] = lower_[i] + v[i] * step_[i];
+  }
+}
+
+void ompl_interface::CompactStateStorage::reserve(std::size_t count)
+{
+  tags_.reserve(count);
+  if (precision_ == FLOAT32)
+    float_values_.reserve(count * variable_count_);
+  else
+    quantized_values_.reserve(count * variable_count_);
+}
+
+void ompl_interface::CompactStateStorage::clear()
+{
+  tags_.clear();
+  float_values_.clear();
+  quantized_values_.clear();
+}
+
+double ompl_interface::CompactStateStorage::getMaxError(unsigned int variable) const
+{
+  if (precision_ == UINT16)
+    return 0.5 * step_[variable];
+
+  // float rounding is relative to the magnitude of the value; bound it using the bounds of the space
+  double magnitude = 0.0;
+  const robot_model::JointBoundsVector &bounds = space_->getJointsBounds();
+  const std::vector<const robot_model::JointModel*> &joints = space_->getJointModelGroup()->getActiveJointModels();
+  for (std::size_t i = 0 ; i < joints.size() && i < bounds.size() ; ++i)
+  {
+    int index = space_->getJointModelGroup()->getVariableGroupIndex(joints[i]->getVariableNames()[0]);
+    if (variable >= (unsigned int)index && variable < index + bounds[i]->size())
+    {
+      const robot_model::VariableBounds &b = (*bounds[i])[variable - index];
+      magnitude = std::max(fabs(b.min_position_), fabs(b.max_position_));
+    }
+  }
+  return magnitude * std::numeric_limits<float>::epsilon() * 0.5;
+}
+
+std::size_t ompl_interface::CompactStateStorage::getMemoryUsage() const
+{
+  return tags_.capacity() * sizeof(boost::int32_t) + float_values_.capacity() * sizeof(float) +
+    quantized_values_.capacity() * sizeof(boost::uint16_t);
+}
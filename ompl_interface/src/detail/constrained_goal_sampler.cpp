@@ -38,24 +38,139 @@
 #include "moveit/ompl_interface/ompl_planning_context.h"
 #include "moveit/ompl_interface/detail/state_validity_checker.h"
 #include <moveit/profiler/profiler.h>
+#include <ompl/util/Time.h>
+
+namespace
+{
+// Longest sleep of a throttled sampling thread before it checks whether sampling stopped
+const double THROTTLE_SLICE = 0.005;
+
+// Sampling priority of a goal region in which the reachability map has no reached voxel.  The map is
+// built from a finite number of samples, so such regions may still have a few goal states.
+const double UNREACHED_REGION_PRIORITY = 0.1;
+}
 
 ompl_interface::ConstrainedGoalSampler::ConstrainedGoalSampler(const OMPLPlanningContext *pc,
                                                                const kinematic_constraints::KinematicConstraintSetPtr &ks,
-                                                               const constraint_samplers::ConstraintSamplerPtr &cs)
+                                                               const constraint_samplers::ConstraintSamplerPtr &cs,
+                                                               const std::vector<constraint_samplers::ConstraintSamplerPtr> &helper_samplers,
+                                                               const GoalSampleCachePtr &cache, GoalSampleCache::Key cache_key)
   : ompl::base::GoalLazySamples(pc->getOMPLSpaceInformation(),
                         boost::bind(&ConstrainedGoalSampler::sampleUsingConstraintSampler, this, _1, _2), false)
   , planning_context_(pc)
   , kinematic_constraint_set_(ks)
-  , constraint_sampler_(cs)
-  , work_state_(pc->getCompleteInitialRobotState())
-  , invalid_sampled_constraints_(0)
-  , warned_invalid_samples_(false)
+  , cache_(cache)
+  , cache_key_(cache_key)
   , verbose_display_(0)
+  , last_call_time_(0.0)
+  , external_(false)
+  , external_calls_(0)
+  , cached_states_(0)
+  , reachable_(true)
 {
-  if (!constraint_sampler_)
-    default_sampler_ = si_->allocStateSampler();
-  ROS_DEBUG("Constructed a ConstrainedGoalSampler instance at address %p", this);
-  startSampling();
+  external_active_ = false;
+  priority_permille_ = 1000;
+  total_attempts_ = 0;
+  sampling_time_us_ = 0;
+  attempts_ = 0;
+  found_ = false;
+  invalid_sampled_constraints_ = 0;
+  warned_invalid_samples_ = false;
+
+  if (cs)
+  {
+    workers_.push_back(WorkerPtr(new Worker(pc->getCompleteInitialRobotState())));
+    workers_.back()->constraint_sampler = cs;
+    for (std::size_t i = 0 ; i < helper_samplers.size() ; ++i)
+    {
+      workers_.push_back(WorkerPtr(new Worker(pc->getCompleteInitialRobotState())));
+      workers_.back()->constraint_sampler = helper_samplers[i];
+    }
+  }
+  else
+    for (unsigned int i = 0 ; i < pc->getGoalSamplingThreads() ; ++i)
+    {
+      workers_.push_back(WorkerPtr(new Worker(pc->getCompleteInitialRobotState())));
+      workers_.back()->default_sampler = si_->allocStateSampler();
+    }
+
+  // the threads of the other workers are only created when sampling starts (see sampleConcurrently())
+  if (workers_.size() > 1)
+    for (std::size_t i = 0 ; i < workers_.size() ; ++i)
+      workers_[i]->goal = si_->allocState();
+
+  ReachabilityMapConstPtr map = pc->getReachabilityMap();
+  bool inside = true;
+  if (map && !isGoalRegionReachable(*map, inside))
+  {
+    if (inside)
+    {
+      setSamplingPriority(UNREACHED_REGION_PRIORITY);
+      ROS_DEBUG("The goal region of link '%s' was not reached while building the reachability map of group '%s'. "
+                "Sampling goals from it with low priority.", map->getTipFrame().c_str(), map->getGroupName().c_str());
+    }
+    else
+    {
+      reachable_ = false;
+      ROS_WARN("The goal region of link '%s' is outside the reachability map of group '%s'. Not sampling goals from it.",
+               map->getTipFrame().c_str(), map->getGroupName().c_str());
+    }
+  }
+  if (cache_ && reachable_)
+    addCachedSamples();
+  // sampling is started by the owner of the goal, or sampling is left to a GoalSamplingPool
+  ROS_DEBUG("Constructed a ConstrainedGoalSampler instance at address %p with %u sampling threads", this, (unsigned int)workers_.size());
+}
+
+ompl_interface::ConstrainedGoalSampler::~ConstrainedGoalSampler()
+{
+  // the sampling thread uses the workers; stop it before they are destroyed
+  stopSampling();
+  for (std::size_t i = 0 ; i < workers_.size() ; ++i)
+    if (workers_[i]->goal)
+      si_->freeState(workers_[i]->goal);
+}
+
+void ompl_interface::ConstrainedGoalSampler::addCachedSamples()
+{
+  std::vector<GoalSampleCache::Sample> samples;
+  if (!cache_->retrieve(cache_key_, samples))
+    return;
+
+  const robot_model::JointModelGroup *jmg = planning_context_->getOMPLStateSpace()->getJointModelGroup();
+  robot_state::RobotState &state = workers_[0]->work_state;
+  ompl::base::State *goal = si_->allocState();
+  unsigned int added = 0;
+  for (std::size_t i = 0 ; i < samples.size() ; ++i)
+  {
+    if (samples[i].size() != jmg->getVariableCount())
+      continue;
+    state.setJointGroupPositions(jmg, samples[i]);
+    state.update();
+    // the key is a hash, and the scene may have changed since the states were stored
+    if (kinematic_constraint_set_->decide(state).satisfied && checkStateValidity(goal, state) &&
+        addStateIfDifferent(goal, minDist_))
+      ++added;
+  }
+  si_->freeState(goal);
+  cached_states_ += added;
+  ROS_DEBUG("Added %u of %u cached goal states", added, (unsigned int)samples.size());
+}
+
+void ompl_interface::ConstrainedGoalSampler::storeSamples()
+{
+  if (!cache_)
+    return;
+
+  const robot_model::JointModelGroup *jmg = planning_context_->getOMPLStateSpace()->getJointModelGroup();
+  robot_state::RobotState state(planning_context_->getCompleteInitialRobotState());
+  std::vector<GoalSampleCache::Sample> samples(getStateCount());
+  for (std::size_t i = 0 ; i < samples.size() ; ++i)
+  {
+    planning_context_->getOMPLStateSpace()->copyToRobotState(state, getState(i));
+    state.copyJointGroupPositions(jmg, samples[i]);
+  }
+  cache_->store(cache_key_, samples);
 }
 
 bool ompl_interface::ConstrainedGoalSampler::checkStateValidity(ompl::base::State* new_goal,
@@ -66,6 +181,48 @@ bool ompl_interface::ConstrainedGoalSampler::checkStateValidity(ompl::base::Stat
   return static_cast<const StateValidityChecker*>(si_->getStateValidityChecker().get())->isValid(new_goal, verbose);
 }
 
+bool ompl_interface::ConstrainedGoalSampler::isGoalRegionReachable(const ReachabilityMap &map, bool &inside)
+{
+  inside = true;
+  const robot_state::RobotState &state = workers_[0]->work_state;
+  if (!state.getRobotModel()->hasLinkModel(map.getBaseFrame()))
+    return true;
+
+  // the map is expressed in its base frame; the group is the only part of the robot that moves
+  const Eigen::Affine3d to_base = state.getGlobalLinkTransform(map.getBaseFrame()).inverse(Eigen::Isometry);
+  const std::vector<kinematic_constraints::PositionConstraintPtr> &constraints = kinematic_constraint_set_->getPositionConstraints();
+  for (std::size_t i = 0 ; i < constraints.size() ; ++i)
+  {
+    const kinematic_constraints::PositionConstraint &pc = *constraints[i];
+    if (!pc.enabled() || pc.mobileReferenceFrame() || pc.getLinkModel()->getName() != map.getTipFrame())
+      continue;
+
+    // the constrained point is offset from the link origin, in an orientation that is not known here;
+    // the box is padded by a voxel, since the map only has the voxels that samples happened to hit
+    bool reachable = false;
+    bool region_inside = false;
+    const std::vector<bodies::BodyPtr> &regions = pc.getConstraintRegions();
+    for (std::size_t j = 0 ; j < regions.size() && !reachable ; ++j)
+    {
+      bodies::BoundingSphere sphere;
+      regions[j]->computeBoundingSphere(sphere);
+      const Eigen::Vector3d center = to_base * sphere.center;
+      const Eigen::Vector3d extent = Eigen::Vector3d::Constant(sphere.radius + pc.getLinkOffset().norm() + map.getResolution());
+      if (map.isRegionInside(center - extent, center + extent))
+      {
+        region_inside = true;
+        reachable = map.isRegionReachable(center - extent, center + extent);
+      }
+    }
+    if (!reachable)
+    {
+      inside = region_inside;
+      return false;
+    }
+  }
+  return true;
+}
+
 bool ompl_interface::ConstrainedGoalSampler::stateValidityCallback(ompl::base::State* new_goal,
                                                                           robot_state::RobotState const* state,
                                                                           const robot_model::JointModelGroup* jmg,
@@ -79,81 +236,208 @@ bool ompl_interface::ConstrainedGoalSampler::stateValidityCallback(ompl::base::S
   return checkStateValidity(new_goal, solution_state, verbose);
 }
 
-bool ompl_interface::ConstrainedGoalSampler::sampleUsingConstraintSampler(const ompl::base::GoalLazySamples *gls, ompl::base::State *new_goal)
+void ompl_interface::ConstrainedGoalSampler::setSamplingPriority(double priority)
 {
-  //  moveit::Profiler::ScopedBlock sblock("ConstrainedGoalSampler::sampleUsingConstraintSampler");
+  priority_permille_ = (unsigned int)(std::min(1.0, std::max(0.0, priority)) * 1000.0 + 0.5);
+}
 
-  //unsigned int max_attempts = planning_context_->getMaximumGoalSamplingAttempts();
-  unsigned int max_attempts = 1000;
-  unsigned int attempts_so_far = gls->samplingAttemptsCount();
+void ompl_interface::ConstrainedGoalSampler::setExternalSampling(bool flag)
+{
+  if (flag)
+    stopSampling();
+  external_ = flag;
+  external_active_ = false;
+}
 
-  // terminate after too many attempts
-  if (attempts_so_far >= max_attempts)
+void ompl_interface::ConstrainedGoalSampler::setExternalSamplingActive(bool flag)
+{
+  external_active_ = flag;
+}
+
+bool ompl_interface::ConstrainedGoalSampler::sampleExternally(ompl::base::State *scratch)
+{
+  if (!external_ || !external_active_ || isExhausted(this))
     return false;
 
+  // a single attempt, so the pool can switch regions often; the workers take turns, so the helper
+  // constraint samplers are used as well
+  unsigned int max_attempts = planning_context_->getMaximumGoalSamplingAttempts();
+  unsigned int attempt = external_calls_++;
+  ompl::time::point start = ompl::time::now();
+  bool result = sampleOnce(*workers_[attempt % workers_.size()], scratch, attempt, isVerboseAttempt(this, attempt, max_attempts));
+  sampling_time_us_ += (unsigned long)(ompl::time::seconds(ompl::time::now() - start) * 1e6);
+
+  // the state was checked for validity by the sampler; this is what the sampling thread of GoalLazySamples does next
+  if (result && si_->satisfiesBounds(scratch))
+    addStateIfDifferent(scratch, minDist_);
+  return true;
+}
+
+bool ompl_interface::ConstrainedGoalSampler::isExhausted(const ompl::base::GoalLazySamples *gls) const
+{
+  // terminate after too many attempts, or when the goal region cannot be reached
+  if (getCallCount(gls) >= planning_context_->getMaximumGoalSamplingAttempts() || !reachable_)
+    return true;
+
   // terminate after a maximum number of samples
-  //if (gls->getStateCount() >= planning_context_->getMaximumGoalSamples())
-  unsigned int max_goal_samples = 50;
-  if (gls->getStateCount() >= max_goal_samples)
-    return false;
+  if (gls->getStateCount() >= planning_context_->getMaximumGoalSamples())
+    return true;
 
   // terminate the sampling thread when a solution has been found
   if (planning_context_->getOMPLProblemDefinition()->hasSolution())
-    return false;
+    return true;
+
+  // terminate when the goal region was given up for others that produce goal states
+  return priority_permille_ == 0;
+}
+
+bool ompl_interface::ConstrainedGoalSampler::isSamplingActive(const ompl::base::GoalLazySamples *gls) const
+{
+  return external_ ? external_active_.load() : gls->isSampling();
+}
+
+unsigned int ompl_interface::ConstrainedGoalSampler::getCallCount(const ompl::base::GoalLazySamples *gls) const
+{
+  return external_ ? external_calls_ : gls->samplingAttemptsCount();
+}
 
-  unsigned int max_attempts_div2 = max_attempts / 2;
-  for (unsigned int a = gls->samplingAttemptsCount() ; a < max_attempts && gls->isSampling() ; ++a)
+void ompl_interface::ConstrainedGoalSampler::throttle(const ompl::base::GoalLazySamples *gls, double duration) const
+{
+  ompl::time::point end = ompl::time::now() + ompl::time::seconds(duration);
+  while (isSamplingActive(gls) && priority_permille_ < 1000)
   {
-    bool verbose = false;
-    if (gls->getStateCount() == 0 && a >= max_attempts_div2)
-      if (verbose_display_ < 1)
-      {
-        verbose = true;
-        verbose_display_++;
-      }
+    double remaining = ompl::time::seconds(end - ompl::time::now());
+    if (remaining <= 0.0)
+      break;
+    boost::this_thread::sleep(boost::posix_time::microseconds((long)(std::min(remaining, THROTTLE_SLICE) * 1e6)));
+  }
+}
+
+bool ompl_interface::ConstrainedGoalSampler::isVerboseAttempt(const ompl::base::GoalLazySamples *gls, unsigned int attempt,
+                                                              unsigned int max_attempts)
+{
+  if (gls->getStateCount() == 0 && attempt >= max_attempts / 2 && verbose_display_ < 1)
+  {
+    verbose_display_++;
+    return true;
+  }
+  return false;
+}
+
+bool ompl_interface::ConstrainedGoalSampler::sampleUsingConstraintSampler(const ompl::base::GoalLazySamples *gls, ompl::base::State *new_goal)
+{
+  //  moveit::Profiler::ScopedBlock sblock("ConstrainedGoalSampler::sampleUsingConstraintSampler");
+
+  if (isExhausted(gls))
+    return false;
+  unsigned int max_attempts = planning_context_->getMaximumGoalSamplingAttempts();
+  unsigned int attempts_so_far = getCallCount(gls);
+
+  // below full priority, keep the share of time spent sampling at the priority
+  unsigned int priority = priority_permille_;
+  if (priority > 0 && priority < 1000 && last_call_time_ > 0.0)
+    throttle(gls, last_call_time_ * (1000 - priority) / priority);
+
+  ompl::time::point start = ompl::time::now();
+  bool result = false;
+  if (workers_.size() > 1)
+    result = sampleConcurrently(gls, new_goal, attempts_so_far);
+  else
+    // the region may be given up while it is sampled
+    for (unsigned int a = attempts_so_far ; a < max_attempts && isSamplingActive(gls) && priority_permille_ > 0 && !result ; ++a)
+      result = sampleOnce(*workers_[0], new_goal, attempts_so_far, isVerboseAttempt(gls, a, max_attempts));
+  last_call_time_ = ompl::time::seconds(ompl::time::now() - start);
+  sampling_time_us_ += (unsigned long)(last_call_time_ * 1e6);
+  return result;
+}
 
-    if (constraint_sampler_)
+bool ompl_interface::ConstrainedGoalSampler::sampleConcurrently(const ompl::base::GoalLazySamples *gls, ompl::base::State *new_goal,
+                                                                unsigned int attempts_so_far)
+{
+  // all workers sample until one of them finds a goal state; the attempts are shared
+  attempts_ = attempts_so_far;
+  found_ = false;
+  // the calling thread runs one of the workers; regions sampled by a GoalSamplingPool never get here
+  if (!pool_)
+    pool_.reset(new WorkerPool(workers_.size() - 1));
+  pool_->run(workers_.size(), boost::bind(&ConstrainedGoalSampler::sampleWorker, this, gls, _1));
+
+  // several workers may have succeeded at the same time; the first state is checked and added by the
+  // sampling thread of GoalLazySamples, the others are added here
+  bool result = false;
+  for (std::size_t i = 0 ; i < workers_.size() ; ++i)
+    if (workers_[i]->found)
     {
-      // makes the constraint sampler also perform a validity callback
-      robot_state::GroupStateValidityCallbackFn gsvcf = boost::bind(&ompl_interface::ConstrainedGoalSampler::stateValidityCallback,
-                                                                    this,
-                                                                    new_goal,
-                                                                    _1,  // pointer to state
-                                                                    _2,  // const* joint model group
-                                                                    _3,  // double* of joint positions
-                                                                    verbose);
-      constraint_sampler_->setGroupStateValidityCallback( gsvcf );
-
-      unsigned int max_state_sampling_attempts = 4;
-      //if (constraint_sampler_->project(work_state_, planning_context_->getMaximumStateSamplingAttempts()))
-      if (constraint_sampler_->project(work_state_, max_state_sampling_attempts))
+      if (result)
+        addStateIfDifferent(workers_[i]->goal, minDist_);
+      else
       {
-        work_state_.update();
-        if (kinematic_constraint_set_->decide(work_state_, verbose).satisfied)
-        {
-          if (checkStateValidity(new_goal, work_state_, verbose))
-            return true;
-        }
-        else
-        {
-          invalid_sampled_constraints_++;
-          if (!warned_invalid_samples_ && invalid_sampled_constraints_ >= (attempts_so_far * 8) / 10)
-          {
-            warned_invalid_samples_ = true;
-            ROS_WARN("More than 80%% of the sampled goal states fail to satisfy the constraints imposed on the goal sampler. Is the constrained sampler working correctly?");
-          }
-        }
+        si_->copyState(new_goal, workers_[i]->goal);
+        result = true;
       }
     }
-    else
+  return result;
+}
+
+void ompl_interface::ConstrainedGoalSampler::sampleWorker(const ompl::base::GoalLazySamples *gls, unsigned int index)
+{
+  Worker &worker = *workers_[index];
+  worker.found = false;
+  unsigned int max_attempts = planning_context_->getMaximumGoalSamplingAttempts();
+  unsigned int attempts_so_far = getCallCount(gls);
+  while (!found_ && isSamplingActive(gls) && priority_permille_ > 0)
+  {
+    unsigned int a = attempts_++;
+    if (a >= max_attempts)
+      break;
+    bool verbose = index == 0 && isVerboseAttempt(gls, a, max_attempts);
+    if (sampleOnce(worker, worker.goal, attempts_so_far, verbose))
     {
-      default_sampler_->sampleUniform(new_goal);
-      if (static_cast<const StateValidityChecker*>(si_->getStateValidityChecker().get())->isValid(new_goal, verbose))
+      worker.found = true;
+      found_ = true;
+    }
+  }
+}
+
+bool ompl_interface::ConstrainedGoalSampler::sampleOnce(Worker &worker, ompl::base::State *new_goal, unsigned int attempts_so_far, bool verbose)
+{
+  ++total_attempts_;
+  if (worker.constraint_sampler)
+  {
+    // makes the constraint sampler also perform a validity callback
+    robot_state::GroupStateValidityCallbackFn gsvcf = boost::bind(&ompl_interface::ConstrainedGoalSampler::stateValidityCallback,
+                                                                  this,
+                                                                  new_goal,
+                                                                  _1,  // pointer to state
+                                                                  _2,  // const* joint model group
+                                                                  _3,  // double* of joint positions
+                                                                  verbose);
+    worker.constraint_sampler->setGroupStateValidityCallback( gsvcf );
+
+    if (worker.constraint_sampler->project(worker.work_state, planning_context_->getMaximumStateSamplingAttempts()))
+    {
+      worker.work_state.update();
+      if (kinematic_constraint_set_->decide(worker.work_state, verbose).satisfied)
       {
-        planning_context_->getOMPLStateSpace()->copyToRobotState(work_state_, new_goal);
-        if (kinematic_constraint_set_->decide(work_state_, verbose).satisfied)
+        if (checkStateValidity(new_goal, worker.work_state, verbose))
           return true;
       }
+      else
+      {
+        unsigned int invalid = ++invalid_sampled_constraints_;
+        if (invalid >= (attempts_so_far * 8) / 10 && !warned_invalid_samples_.exchange(true))
+          ROS_WARN("More than 80%% of the sampled goal states fail to satisfy the constraints imposed on the goal sampler. Is the constrained sampler working correctly?");
+      }
+    }
+  }
+  else
+  {
+    worker.default_sampler->sampleUniform(new_goal);
+    if (static_cast<const StateValidityChecker*>(si_->getStateValidityChecker().get())->isValid(new_goal, verbose))
+    {
+      planning_context_->getOMPLStateSpace()->copyToRobotState(worker.work_state, new_goal);
+      if (kinematic_constraint_set_->decide(worker.work_state, verbose).satisfied)
+        return true;
     }
   }
   return false;
@@ -0,0 +1,181 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/constrained_sample_producer.h"
+#include "moveit/ompl_interface/ompl_planning_context.h"
+#include <ros/console.h>
+
+namespace
+{
+// Time a thread waits for the consumers when all states hold samples
+const unsigned int FULL_BUFFER_WAIT_US = 200;
+}
+
+ompl_interface::ConstrainedSampleProducer::ConstrainedSampleProducer(const OMPLPlanningContext *pc, const ConstraintSamplerAllocator &csa,
+                                                                     unsigned int thread_count, std::size_t capacity)
+  : planning_context_(pc)
+  , space_(pc->getOMPLStateSpace())
+  , allocator_(csa)
+  , thread_count_(thread_count)
+  , capacity_(capacity)
+  , free_(capacity)
+  , ready_(capacity)
+  , running_(false)
+  , run_time_(0.0)
+{
+  stop_ = false;
+  resetCounters();
+}
+
+ompl_interface::ConstrainedSampleProducer::~ConstrainedSampleProducer()
+{
+  releaseStates();
+}
+
+void ompl_interface::ConstrainedSampleProducer::start()
+{
+  if (running_)
+    return;
+  if (states_.empty())
+  {
+    // both rings can hold all of the states, so moving a state from one to the other never fails
+    states_.resize(capacity_);
+    for (std::size_t i = 0 ; i < capacity_ ; ++i)
+    {
+      states_[i] = space_->allocState();
+      free_.push(states_[i]);
+    }
+  }
+  stop_ = false;
+  running_ = true;
+  start_time_ = ompl::time::now();
+  for (unsigned int i = 0 ; i < thread_count_ ; ++i)
+    threads_.create_thread(boost::bind(&ConstrainedSampleProducer::producer, this));
+}
+
+void ompl_interface::ConstrainedSampleProducer::stop()
+{
+  if (!running_)
+    return;
+  stop_ = true;
+  threads_.join_all();
+  running_ = false;
+  run_time_ += ompl::time::seconds(ompl::time::now() - start_time_);
+}
+
+void ompl_interface::ConstrainedSampleProducer::releaseStates()
+{
+  stop();
+  // with the threads stopped, every state is in one of the rings
+  ompl::base::State *state;
+  while (free_.pop(state))
+    ;
+  while (ready_.pop(state))
+    ;
+  for (std::size_t i = 0 ; i < states_.size() ; ++i)
+    space_->freeState(states_[i]);
+  states_.clear();
+}
+
+double ompl_interface::ConstrainedSampleProducer::getRunTime() const
+{
+  return running_ ? run_time_ + ompl::time::seconds(ompl::time::now() - start_time_) : run_time_;
+}
+
+void ompl_interface::ConstrainedSampleProducer::resetCounters()
+{
+  produced_ = 0;
+  consumed_ = 0;
+  misses_ = 0;
+  failed_draws_ = 0;
+  run_time_ = 0.0;
+  if (running_)
+    start_time_ = ompl::time::now();
+}
+
+bool ompl_interface::ConstrainedSampleProducer::consume(ompl::base::State *state)
+{
+  ompl::base::State *sample;
+  if (!ready_.pop(sample))
+  {
+    ++misses_;
+    return false;
+  }
+  space_->copyState(state, sample);
+  free_.push(sample);
+  ++consumed_;
+  return true;
+}
+
+void ompl_interface::ConstrainedSampleProducer::producer()
+{
+  constraint_samplers::ConstraintSamplerPtr sampler = allocator_();
+  if (!sampler)
+  {
+    ROS_ERROR("Unable to allocate a constraint sampler for background sampling");
+    return;
+  }
+
+  const robot_state::RobotState &reference_state = planning_context_->getCompleteInitialRobotState();
+  robot_state::RobotState work_state(reference_state);
+  const unsigned int max_attempts = planning_context_->getMaximumStateSamplingAttempts();
+
+  ompl::base::State *state = NULL;
+  while (!stop_)
+  {
+    if (!state && !free_.pop(state))
+    {
+      // every state holds a sample; the consumers are slower than this thread
+      state = NULL;
+      boost::this_thread::sleep(boost::posix_time::microseconds(FULL_BUFFER_WAIT_US));
+      continue;
+    }
+
+    if (sampler->sample(work_state, reference_state, max_attempts))
+    {
+      space_->copyToOMPLState(state, work_state);
+      if (space_->satisfiesBounds(state))
+      {
+        ready_.push(state);
+        state = NULL;
+        ++produced_;
+        continue;
+      }
+    }
+    ++failed_draws_;
+  }
+
+  if (state)
+    free_.push(state);
+}
@@ -36,17 +36,125 @@
 
 #include "moveit/ompl_interface/detail/constrained_sampler.h"
 #include <moveit/profiler/profiler.h>
+#include <algorithm>
+#include <chrono>
 
-ompl_interface::ConstrainedSampler::ConstrainedSampler(const OMPLPlanningContext *pc, const constraint_samplers::ConstraintSamplerPtr &cs)
+namespace
+{
+// Every available strategy keeps at least this share of the draws
+const double MINIMUM_SHARE = 0.05;
+// The mix is recomputed after this many draws
+const unsigned int MIX_UPDATE_PERIOD = 32;
+// The statistics of a strategy are halved once it was drawn this many times, so the mix follows changes
+const double DECAY_WINDOW = 512.0;
+// Assumed duration of a draw of a strategy that was never drawn
+const double UNKNOWN_DRAW_TIME = 1e-4;
+}
+
+ompl_interface::ConstrainedSampler::ConstrainedSampler(const OMPLPlanningContext *pc, const constraint_samplers::ConstraintSamplerPtr &cs,
+                                                       const ConstrainedSampleProducerPtr &producer)
   : ompl::base::StateSampler(pc->getOMPLStateSpace().get())
   , planning_context_(pc)
   , default_(space_->allocDefaultStateSampler())
   , constraint_sampler_(cs)
+  , producer_(producer)
   , work_state_(pc->getCompleteInitialRobotState())
   , constrained_success_(0)
   , constrained_failure_(0)
+  , draws_since_update_(0)
 {
   inv_dim_ = space_->getDimension() > 0 ? 1.0 / (double)space_->getDimension() : 1.0;
+
+  available_[CONSTRAINT_SAMPLER] = true;
+  available_[PROJECTION] = true;
+  // rejection needs the path constraints to check the samples against
+  available_[REJECTION] = (bool)planning_context_->getPathConstraints();
+  updateMix();
+}
+
+ompl_interface::ConstrainedSampler::~ConstrainedSampler()
+{
+  ROS_DEBUG("Constrained sampling mix: constraint sampler %.2f (success %.2f), rejection %.2f (success %.2f), projection %.2f (success %.2f)",
+            mix_[CONSTRAINT_SAMPLER], getSuccessRate(CONSTRAINT_SAMPLER), mix_[REJECTION], getSuccessRate(REJECTION),
+            mix_[PROJECTION], getSuccessRate(PROJECTION));
+}
+
+void ompl_interface::ConstrainedSampler::getSamplingMix(double mix[STRATEGY_COUNT]) const
+{
+  for (int i = 0 ; i < STRATEGY_COUNT ; ++i)
+    mix[i] = mix_[i];
+}
+
+double ompl_interface::ConstrainedSampler::getSuccessRate(Strategy strategy) const
+{
+  const StrategyStatistics &st = statistics_[strategy];
+  return st.attempts > 0.0 ? st.successes / st.attempts : 0.0;
+}
+
+void ompl_interface::ConstrainedSampler::updateMix()
+{
+  // the score of a strategy is its expected number of samples per second; the success rate has a
+  // uniform prior, so strategies that were rarely drawn are neither favored nor discarded
+  double score[STRATEGY_COUNT];
+  double total = 0.0;
+  unsigned int available = 0;
+  for (int i = 0 ; i < STRATEGY_COUNT ; ++i)
+  {
+    score[i] = 0.0;
+    if (!available_[i])
+      continue;
+    ++available;
+    const StrategyStatistics &st = statistics_[i];
+    double rate = (st.successes + 1.0) / (st.attempts + 2.0);
+    double time = st.attempts > 0.0 ? st.time / st.attempts : UNKNOWN_DRAW_TIME;
+    score[i] = rate / std::max(time, 1e-9);
+    total += score[i];
+  }
+  for (int i = 0 ; i < STRATEGY_COUNT ; ++i)
+    mix_[i] = available_[i] ? MINIMUM_SHARE + (1.0 - available * MINIMUM_SHARE) * score[i] / total : 0.0;
+  draws_since_update_ = 0;
+}
+
+bool ompl_interface::ConstrainedSampler::sampleAdaptive(ompl::base::State *state)
+{
+  if (++draws_since_update_ >= MIX_UPDATE_PERIOD)
+    updateMix();
+
+  int strategy = 0;
+  double r = rng_.uniform01();
+  while (strategy < STRATEGY_COUNT - 1 && (r >= mix_[strategy] || !available_[strategy]))
+  {
+    r -= mix_[strategy];
+    ++strategy;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool valid;
+  switch (strategy)
+  {
+  case REJECTION:
+    valid = sampleRejection(state);
+    break;
+  case PROJECTION:
+    valid = sampleProjection(state);
+    break;
+  default:
+    valid = sampleC(state);
+    break;
+  }
+
+  StrategyStatistics &st = statistics_[strategy];
+  st.attempts += 1.0;
+  if (valid)
+    st.successes += 1.0;
+  st.time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (st.attempts >= DECAY_WINDOW)
+  {
+    st.attempts *= 0.5;
+    st.successes *= 0.5;
+    st.time *= 0.5;
+  }
+  return valid;
 }
 
 double ompl_interface::ConstrainedSampler::getConstrainedSamplingRate() const
@@ -61,8 +169,14 @@ bool ompl_interface::ConstrainedSampler::sampleC(ompl::base::State *state)
 {
   //  moveit::Profiler::ScopedBlock sblock("sampleWithConstraints");
 
-  //unsigned int max_attempts = planning_context_->getMaximumStateSamplingAttempts();
-  unsigned int max_attempts = 4;
+  // samples of the background threads already satisfy the constraints and the bounds
+  if (producer_ && producer_->isRunning() && producer_->consume(state))
+  {
+    ++constrained_success_;
+    return true;
+  }
+
+  unsigned int max_attempts = planning_context_->getMaximumStateSamplingAttempts();
 
   if (constraint_sampler_->sample(work_state_, planning_context_->getCompleteInitialRobotState(), max_attempts))
   {
@@ -77,15 +191,37 @@ bool ompl_interface::ConstrainedSampler::sampleC(ompl::base::State *state)
   return false;
 }
 
+bool ompl_interface::ConstrainedSampler::sampleRejection(ompl::base::State *state)
+{
+  default_->sampleUniform(state);
+  planning_context_->getOMPLStateSpace()->copyToRobotState(work_state_, state);
+  work_state_.update();
+  return planning_context_->getPathConstraints()->decide(work_state_).satisfied;
+}
+
+bool ompl_interface::ConstrainedSampler::sampleProjection(ompl::base::State *state)
+{
+  unsigned int max_attempts = planning_context_->getMaximumStateSamplingAttempts();
+
+  default_->sampleUniform(state);
+  planning_context_->getOMPLStateSpace()->copyToRobotState(work_state_, state);
+  if (constraint_sampler_->project(work_state_, max_attempts))
+  {
+    planning_context_->getOMPLStateSpace()->copyToOMPLState(state, work_state_);
+    return space_->satisfiesBounds(state);
+  }
+  return false;
+}
+
 void ompl_interface::ConstrainedSampler::sampleUniform(ompl::base::State *state)
 {
-  if (!sampleC(state) && !sampleC(state) && !sampleC(state))
+  if (!sampleAdaptive(state) && !sampleAdaptive(state) && !sampleAdaptive(state))
     default_->sampleUniform(state);
 }
 
 void ompl_interface::ConstrainedSampler::sampleUniformNear(ompl::base::State *state, const ompl::base::State *near, const double distance)
 {
-  if (sampleC(state) || sampleC(state) || sampleC(state))
+  if (sampleAdaptive(state) || sampleAdaptive(state) || sampleAdaptive(state))
   {
     double total_d = space_->distance(state, near);
     if (total_d > distance)
@@ -100,7 +236,7 @@ void ompl_interface::ConstrainedSampler::sampleUniformNear(ompl::base::State *st
 
 void ompl_interface::ConstrainedSampler::sampleGaussian(ompl::base::State *state, const ompl::base::State *mean, const double stdDev)
 {
-  if (sampleC(state) || sampleC(state) || sampleC(state))
+  if (sampleAdaptive(state) || sampleAdaptive(state) || sampleAdaptive(state))
   {
     double total_d = space_->distance(state, mean);
     double distance = rng_.gaussian(0.0, stdDev);
@@ -0,0 +1,159 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/goal_sample_cache.h"
+#include <ros/serialization.h>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+
+ompl_interface::GoalSampleCache::GoalSampleCache(std::size_t max_goals, std::size_t max_samples_per_goal)
+  : max_goals_(max_goals)
+  , max_samples_per_goal_(max_samples_per_goal)
+  , use_counter_(0)
+  , hits_(0)
+  , misses_(0)
+{
+}
+
+ompl_interface::GoalSampleCache::Key ompl_interface::GoalSampleCache::computeKey(const std::string &group, const moveit_msgs::Constraints &goal)
+{
+  // the stamps differ from one request to the next; the frames do not
+  moveit_msgs::Constraints c = goal;
+  for (std::size_t i = 0 ; i < c.position_constraints.size() ; ++i)
+    c.position_constraints[i].header.stamp = ros::Time();
+  for (std::size_t i = 0 ; i < c.orientation_constraints.size() ; ++i)
+    c.orientation_constraints[i].header.stamp = ros::Time();
+  for (std::size_t i = 0 ; i < c.visibility_constraints.size() ; ++i)
+    c.visibility_constraints[i].target_pose.header.stamp = ros::Time();
+
+  uint32_t length = ros::serialization::serializationLength(c);
+  std::vector<uint8_t> buffer(length);
+  ros::serialization::OStream stream(buffer.data(), length);
+  ros::serialization::serialize(stream, c);
+
+  std::size_t key = boost::hash<std::string>()(group);
+  boost::hash_combine(key, boost::hash_range(buffer.begin(), buffer.end()));
+  return key;
+}
+
+void ompl_interface::GoalSampleCache::store(Key key, const std::vector<Sample> &samples)
+{
+  if (samples.empty())
+    return;
+
+  boost::mutex::scoped_lock slock(lock_);
+  std::map<Key, Entry>::iterator it = entries_.find(key);
+  if (it == entries_.end())
+  {
+    if (entries_.size() >= max_goals_ && !entries_.empty())
+    {
+      std::map<Key, Entry>::iterator oldest = entries_.begin();
+      for (std::map<Key, Entry>::iterator jt = entries_.begin() ; jt != entries_.end() ; ++jt)
+        if (jt->second.last_use < oldest->second.last_use)
+          oldest = jt;
+      entries_.erase(oldest);
+    }
+    it = entries_.insert(std::make_pair(key, Entry())).first;
+  }
+
+  Entry &entry = it->second;
+  std::vector<Sample> merged(samples.begin(), samples.begin() + std::min(samples.size(), max_samples_per_goal_));
+  for (std::size_t i = 0 ; i < entry.samples.size() && merged.size() < max_samples_per_goal_ ; ++i)
+    if (std::find(samples.begin(), samples.end(), entry.samples[i]) == samples.end())
+      merged.push_back(entry.samples[i]);
+  entry.samples.swap(merged);
+  entry.last_use = ++use_counter_;
+}
+
+bool ompl_interface::GoalSampleCache::retrieve(Key key, std::vector<Sample> &samples)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  std::map<Key, Entry>::iterator it = entries_.find(key);
+  if (it == entries_.end())
+  {
+    ++misses_;
+    samples.clear();
+    return false;
+  }
+  ++hits_;
+  it->second.last_use = ++use_counter_;
+  samples = it->second.samples;
+  return true;
+}
+
+void ompl_interface::GoalSampleCache::clear()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  entries_.clear();
+}
+
+std::size_t ompl_interface::GoalSampleCache::getGoalCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return entries_.size();
+}
+
+unsigned long ompl_interface::GoalSampleCache::getHitCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return hits_;
+}
+
+unsigned long ompl_interface::GoalSampleCache::getMissCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return misses_;
+}
+
+std::size_t ompl_interface::GoalSampleCache::getSampleCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  std::size_t count = 0;
+  for (std::map<Key, Entry>::const_iterator it = entries_.begin() ; it != entries_.end() ; ++it)
+    count += it->second.samples.size();
+  return count;
+}
+
+std::size_t ompl_interface::GoalSampleCache::getMemoryUsage() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  std::size_t bytes = entries_.size() * sizeof(std::map<Key, Entry>::value_type);
+  for (std::map<Key, Entry>::const_iterator it = entries_.begin() ; it != entries_.end() ; ++it)
+  {
+    bytes += it->second.samples.capacity() * sizeof(Sample);
+    for (std::size_t i = 0 ; i < it->second.samples.size() ; ++i)
+      bytes += it->second.samples[i].capacity() * sizeof(double);
+  }
+  return bytes;
+}
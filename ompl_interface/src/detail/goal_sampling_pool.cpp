@@ -0,0 +1,150 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/goal_sampling_pool.h"
+#include "moveit/ompl_interface/detail/constrained_goal_sampler.h"
+#include <ompl/util/Time.h>
+
+namespace
+{
+// Priority used for the stride of regions with a lower priority, so their pass stays finite
+const double MINIMUM_STRIDE_PRIORITY = 0.01;
+}
+
+ompl_interface::GoalSamplingPool::GoalSamplingPool(const std::vector<ConstrainedGoalSampler*> &regions, unsigned int thread_count)
+  : thread_count_(std::max(1u, thread_count))
+  , active_(0)
+  , running_(false)
+  , stop_(false)
+{
+  regions_.resize(regions.size());
+  for (std::size_t i = 0 ; i < regions.size() ; ++i)
+  {
+    regions_[i].sampler = regions[i];
+    regions_[i].sampler->setExternalSampling(true);
+  }
+}
+
+ompl_interface::GoalSamplingPool::~GoalSamplingPool()
+{
+  stop();
+  for (std::size_t i = 0 ; i < regions_.size() ; ++i)
+    regions_[i].sampler->setExternalSampling(false);
+}
+
+void ompl_interface::GoalSamplingPool::start()
+{
+  if (running_ || regions_.empty())
+    return;
+  for (std::size_t i = 0 ; i < regions_.size() ; ++i)
+  {
+    regions_[i].pass = 0.0;
+    regions_[i].busy = false;
+    regions_[i].done = false;
+    regions_[i].sampler->setExternalSamplingActive(true);
+  }
+  active_ = regions_.size();
+  stop_ = false;
+  running_ = true;
+  for (unsigned int i = 0 ; i < thread_count_ ; ++i)
+    threads_.create_thread(boost::bind(&GoalSamplingPool::worker, this));
+}
+
+void ompl_interface::GoalSamplingPool::stop()
+{
+  if (!running_)
+    return;
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    stop_ = true;
+  }
+  for (std::size_t i = 0 ; i < regions_.size() ; ++i)
+    regions_[i].sampler->setExternalSamplingActive(false);
+  released_.notify_all();
+  threads_.join_all();
+  running_ = false;
+}
+
+bool ompl_interface::GoalSamplingPool::isSampling() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return running_ && !stop_ && active_ > 0;
+}
+
+int ompl_interface::GoalSamplingPool::claim() const
+{
+  int index = -1;
+  for (std::size_t i = 0 ; i < regions_.size() ; ++i)
+    if (!regions_[i].busy && !regions_[i].done && (index < 0 || regions_[i].pass < regions_[index].pass))
+      index = i;
+  return index;
+}
+
+void ompl_interface::GoalSamplingPool::worker()
+{
+  ompl::base::State *scratch = regions_[0].sampler->getSpaceInformation()->allocState();
+
+  boost::mutex::scoped_lock slock(lock_);
+  while (!stop_ && active_ > 0)
+  {
+    int index = claim();
+    if (index < 0)
+    {
+      // the regions left are all being sampled by other threads
+      released_.wait(slock);
+      continue;
+    }
+    Region &region = regions_[index];
+    region.busy = true;
+    slock.unlock();
+
+    ompl::time::point start = ompl::time::now();
+    // a region is done when it refuses to sample, not when an attempt finds no goal state
+    bool more = region.sampler->sampleExternally(scratch);
+    double duration = ompl::time::seconds(ompl::time::now() - start);
+
+    slock.lock();
+    region.busy = false;
+    region.pass += duration / std::max(region.sampler->getSamplingPriority(), MINIMUM_STRIDE_PRIORITY);
+    if (!more)
+    {
+      region.done = true;
+      --active_;
+    }
+    released_.notify_all();
+  }
+  slock.unlock();
+
+  regions_[0].sampler->getSpaceInformation()->freeState(scratch);
+}
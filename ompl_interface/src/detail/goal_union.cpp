@@ -35,10 +35,22 @@
 /* Author: Ioan Sucan */
 
 #include "moveit/ompl_interface/detail/goal_union.h"
+#include "moveit/ompl_interface/detail/constrained_goal_sampler.h"
+#include "moveit/ompl_interface/detail/joint_space_nearest_neighbors.h"
 #include <ompl/base/goals/GoalLazySamples.h>
+#include <ompl/datastructures/NearestNeighborsGNAT.h>
 
 namespace
 {
+// Time between updates of the sampling priorities, in seconds
+const double SCHEDULE_PERIOD = 0.05;
+// Attempts a goal region gets before its yield is compared to the others
+const unsigned long EXPLORATION_ATTEMPTS = 20;
+// Attempts without a goal state after which a goal region is given up, if other regions have goal states
+const unsigned long HOPELESS_ATTEMPTS = 100;
+// Lowest priority of a goal region that produces goal states
+const double MINIMUM_PRIORITY = 0.1;
+
 ompl::base::SpaceInformationPtr getGoalsSI(const std::vector<ompl::base::GoalPtr> &goals)
 {
   if (goals.empty())
@@ -53,47 +65,194 @@ ompl::base::SpaceInformationPtr getGoalsSI(const std::vector<ompl::base::GoalPtr
 }
 }
 
-ompl_interface::GoalSampleableRegionMux::GoalSampleableRegionMux(const std::vector<ompl::base::GoalPtr> &goals) :
-  ompl::base::GoalSampleableRegion(getGoalsSI(goals)), goals_(goals), gindex_(0)
+ompl_interface::GoalSampleableRegionMux::GoalSampleableRegionMux(const std::vector<ompl::base::GoalPtr> &goals, unsigned int pool_threads) :
+  ompl::base::GoalSampleableRegion(getGoalsSI(goals)), goals_(goals), gindex_(0), last_schedule_(ompl::time::now())
+{
+  for (std::size_t i = 0 ; i < goals_.size() ; ++i)
+    samplers_.push_back(dynamic_cast<ConstrainedGoalSampler*>(goals_[i].get()));
+
+  if (JointSpaceMetric::getCurrent())
+    goal_states_.reset(new NearestNeighborsJointSpace<GoalState*>());
+  else
+    goal_states_.reset(new ompl::NearestNeighborsGNAT<GoalState*>());
+  goal_states_->setDistanceFunction(boost::bind(&GoalSampleableRegionMux::distanceGoalStates, this, _1, _2));
+
+  std::vector<ConstrainedGoalSampler*> pooled;
+  for (std::size_t i = 0 ; i < samplers_.size() ; ++i)
+  {
+    if (!samplers_[i])
+      continue;
+    // the callback cannot be set while the sampling thread of the region runs; regions are normally
+    // created stopped, so this only stops regions that were started by their owner
+    bool sampling = samplers_[i]->isSampling();
+    samplers_[i]->stopSampling();
+    samplers_[i]->setNewStateCallback(boost::bind(&GoalSampleableRegionMux::addGoalState, this, (unsigned int)i, _1));
+    for (unsigned int j = 0 ; j < samplers_[i]->getStateCount() ; ++j)
+      addGoalState(i, samplers_[i]->getState(j));
+
+    if (pool_threads > 0)
+      pooled.push_back(samplers_[i]);
+    else if (sampling)
+      samplers_[i]->startSampling();
+  }
+  if (!pooled.empty())
+    pool_.reset(new GoalSamplingPool(pooled, pool_threads));
+}
+
+ompl_interface::GoalSampleableRegionMux::~GoalSampleableRegionMux()
 {
+  pool_.reset();
+  // the regions are shared and may outlive the mux; they must not call it anymore
+  for (std::size_t i = 0 ; i < samplers_.size() ; ++i)
+    if (samplers_[i])
+    {
+      samplers_[i]->stopSampling();
+      samplers_[i]->setNewStateCallback(ompl::base::NewStateCallbackFn());
+    }
+  for (std::size_t i = 0 ; i < goal_state_storage_.size() ; ++i)
+  {
+    si_->freeState(goal_state_storage_[i]->state);
+    delete goal_state_storage_[i];
+  }
 }
 
 void ompl_interface::GoalSampleableRegionMux::startSampling()
 {
+  for (std::size_t i = 0 ; i < samplers_.size() ; ++i)
+    if (samplers_[i])
+      samplers_[i]->setSamplingPriority(1.0);
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
-    if (goals_[i]->hasType(ompl::base::GOAL_LAZY_SAMPLES))
+    if (goals_[i]->hasType(ompl::base::GOAL_LAZY_SAMPLES) && !(samplers_[i] && samplers_[i]->isSampledExternally()))
       static_cast<ompl::base::GoalLazySamples*>(goals_[i].get())->startSampling();
+  if (pool_)
+    pool_->start();
 }
 
 void ompl_interface::GoalSampleableRegionMux::stopSampling()
 {
+  if (pool_)
+    pool_->stop();
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
     if (goals_[i]->hasType(ompl::base::GOAL_LAZY_SAMPLES))
       static_cast<ompl::base::GoalLazySamples*>(goals_[i].get())->stopSampling();
+  unsigned int abandoned = getAbandonedGoalCount();
+  if (abandoned > 0)
+    ROS_DEBUG("Gave up sampling %u of %u goal regions that produced no goal states", abandoned, (unsigned int)goals_.size());
+}
+
+void ompl_interface::GoalSampleableRegionMux::addGoalState(unsigned int goal, const ompl::base::State *st)
+{
+  GoalState *gs = new GoalState();
+  gs->state = si_->cloneState(st);
+  gs->goal = goal;
+  boost::mutex::scoped_lock slock(goal_states_lock_);
+  goal_state_storage_.push_back(gs);
+  goal_states_->add(gs);
+}
+
+double ompl_interface::GoalSampleableRegionMux::nearestGoalState(const ompl::base::State *st, unsigned int &goal) const
+{
+  boost::mutex::scoped_lock slock(goal_states_lock_);
+  if (goal_states_->size() == 0)
+    return std::numeric_limits<double>::infinity();
+  GoalState query;
+  query.state = const_cast<ompl::base::State*>(st);
+  query.goal = 0;
+  GoalState *q = &query;
+  GoalState *nearest = goal_states_->nearest(q);
+  goal = nearest->goal;
+  return si_->distance(st, nearest->state);
+}
+
+double ompl_interface::GoalSampleableRegionMux::distanceGoalStates(const GoalState* const &a, const GoalState* const &b) const
+{
+  return si_->distance(a->state, b->state);
+}
+
+unsigned int ompl_interface::GoalSampleableRegionMux::getAbandonedGoalCount() const
+{
+  unsigned int count = 0;
+  for (std::size_t i = 0 ; i < samplers_.size() ; ++i)
+    if (samplers_[i] && samplers_[i]->getSamplingPriority() <= 0.0)
+      ++count;
+  return count;
+}
+
+void ompl_interface::GoalSampleableRegionMux::updateSchedule() const
+{
+  boost::unique_lock<boost::mutex> slock(schedule_lock_, boost::try_to_lock);
+  if (!slock.owns_lock())
+    return;
+  ompl::time::point now = ompl::time::now();
+  if (ompl::time::seconds(now - last_schedule_) < SCHEDULE_PERIOD)
+    return;
+  last_schedule_ = now;
+
+  // the yield of a region is its number of goal states per second of sampling; states taken from the goal
+  // sample cache cost no sampling time, so they are not counted
+  std::vector<double> yield(samplers_.size(), 0.0);
+  double best_yield = 0.0;
+  for (std::size_t i = 0 ; i < samplers_.size() ; ++i)
+    if (samplers_[i])
+    {
+      double time = std::max(samplers_[i]->getSamplingTime(), 1e-3);
+      yield[i] = samplers_[i]->getSampledStateCount() / time;
+      best_yield = std::max(best_yield, yield[i]);
+    }
+  if (best_yield <= 0.0)
+    return;
+
+  for (std::size_t i = 0 ; i < samplers_.size() ; ++i)
+  {
+    ConstrainedGoalSampler *sampler = samplers_[i];
+    if (!sampler || sampler->getSamplingPriority() <= 0.0 || sampler->getAttemptCount() < EXPLORATION_ATTEMPTS)
+      continue;
+    if (sampler->getStateCount() == 0)
+    {
+      if (sampler->getAttemptCount() >= HOPELESS_ATTEMPTS)
+        sampler->setSamplingPriority(0.0);
+    }
+    else
+      sampler->setSamplingPriority(std::max(MINIMUM_PRIORITY, yield[i] / best_yield));
+  }
 }
 
 void ompl_interface::GoalSampleableRegionMux::sampleGoal(ompl::base::State *st) const
 {
+  updateSchedule();
+
+  // take turns among the goals that have states
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
   {
-    if (goals_[gindex_]->as<ompl::base::GoalSampleableRegion>()->maxSampleCount() > 0)
+    unsigned int index = gindex_;
+    gindex_ = (index + 1) % goals_.size();
+    if (goals_[index]->as<ompl::base::GoalSampleableRegion>()->maxSampleCount() > 0)
     {
-      goals_[gindex_]->as<ompl::base::GoalSampleableRegion>()->sampleGoal(st);
+      goals_[index]->as<ompl::base::GoalSampleableRegion>()->sampleGoal(st);
       return;
     }
-    gindex_ = (gindex_ + 1) % goals_.size();
   }
   throw ompl::Exception("There are no states to sample");
 }
 
 unsigned int ompl_interface::GoalSampleableRegionMux::maxSampleCount() const
 {
+  updateSchedule();
   unsigned int sc = 0;
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
     sc += goals_[i]->as<GoalSampleableRegion>()->maxSampleCount();
   return sc;
 }
 
+std::size_t ompl_interface::GoalSampleableRegionMux::getStateCount() const
+{
+  std::size_t count = 0;
+  for (std::size_t i = 0 ; i < goals_.size() ; ++i)
+    if (goals_[i]->hasType(ompl::base::GOAL_STATES))
+      count += goals_[i]->as<ompl::base::GoalStates>()->getStateCount();
+  return count;
+}
+
 bool ompl_interface::GoalSampleableRegionMux::canSample() const
 {
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
@@ -104,6 +263,8 @@ bool ompl_interface::GoalSampleableRegionMux::canSample() const
 
 bool ompl_interface::GoalSampleableRegionMux::couldSample() const
 {
+  if (pool_ && pool_->isSampling())
+    return true;
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
     if (goals_[i]->as<ompl::base::GoalSampleableRegion>()->couldSample())
       return true;
@@ -112,21 +273,44 @@ bool ompl_interface::GoalSampleableRegionMux::couldSample() const
 
 bool ompl_interface::GoalSampleableRegionMux::isSatisfied(const ompl::base::State *st, double *distance) const
 {
+  // the states of the ConstrainedGoalSampler regions are all in goal_states_
+  unsigned int goal = 0;
+  double min_d = nearestGoalState(st, goal);
+  if (min_d <= goals_[goal]->as<ompl::base::GoalRegion>()->getThreshold())
+  {
+    if (distance)
+      *distance = min_d;
+    return true;
+  }
+
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
-    if (goals_[i]->isSatisfied(st, distance))
-      return true;
+    if (!samplers_[i])
+    {
+      double d = std::numeric_limits<double>::infinity();
+      if (goals_[i]->isSatisfied(st, &d))
+      {
+        if (distance)
+          *distance = d;
+        return true;
+      }
+      min_d = std::min(min_d, d);
+    }
+  if (distance)
+    *distance = min_d;
   return false;
 }
 
 double ompl_interface::GoalSampleableRegionMux::distanceGoal(const ompl::base::State *st) const
 {
-  double min_d = std::numeric_limits<double>::infinity();
+  unsigned int goal;
+  double min_d = nearestGoalState(st, goal);
   for (std::size_t i = 0 ; i < goals_.size() ; ++i)
-  {
-    double d = goals_[i]->as<ompl::base::GoalRegion>()->distanceGoal(st);
-    if (d < min_d)
-      min_d = d;
-  }
+    if (!samplers_[i])
+    {
+      double d = goals_[i]->as<ompl::base::GoalRegion>()->distanceGoal(st);
+      if (d < min_d)
+        min_d = d;
+    }
   return min_d;
 }
 
@@ -0,0 +1,101 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/joint_path_constraint_table.h"
+#include <moveit/kinematic_constraints/kinematic_constraint.h>
+#include <ros/console.h>
+#include <algorithm>
+#include <limits>
+
+ompl_interface::JointPathConstraintTable::JointPathConstraintTable(const robot_model::RobotModelConstPtr &robot_model,
+                                                                   const robot_model::JointModelGroup *jmg,
+                                                                   const moveit_msgs::Constraints &constraints)
+  : jmg_(jmg)
+  , valid_(false)
+{
+  if (constraints.joint_constraints.empty() || !constraints.position_constraints.empty() ||
+      !constraints.orientation_constraints.empty() || !constraints.visibility_constraints.empty())
+    return;
+
+  const std::vector<const robot_model::JointModel*> &active = jmg_->getActiveJointModels();
+  for (std::size_t i = 0 ; i < constraints.joint_constraints.size() ; ++i)
+  {
+    // Let MoveIt interpret the constraint, so the table agrees with KinematicConstraintSet
+    kinematic_constraints::JointConstraint jc(robot_model);
+    if (!jc.configure(constraints.joint_constraints[i]))
+      return;
+
+    const robot_model::JointModel *jm = jc.getJointModel();
+    if (jm->getVariableCount() != 1 || jc.getJointVariableName() != jm->getName())
+      return;  // multi-dof joints are not supported
+    if (jm->getType() == robot_model::JointModel::REVOLUTE && static_cast<const robot_model::RevoluteJointModel*>(jm)->isContinuous())
+      return;  // continuous joints require wrapping
+
+    std::vector<const robot_model::JointModel*>::const_iterator it = std::find(active.begin(), active.end(), jm);
+    if (it == active.end())
+      return;  // joint is not part of the state
+
+    Entry e;
+    e.index = jmg_->getVariableGroupIndex(jm->getName());
+    e.joint = it - active.begin();
+    e.position = jc.getDesiredJointPosition();
+    // same tolerance as kinematic_constraints::JointConstraint::decide()
+    e.above = jc.getJointToleranceAbove() + 2.0 * std::numeric_limits<double>::epsilon();
+    e.below = -jc.getJointToleranceBelow() - 2.0 * std::numeric_limits<double>::epsilon();
+    e.weight = jc.getConstraintWeight();
+    entries_.push_back(e);
+  }
+  valid_ = true;
+}
+
+void ompl_interface::JointPathConstraintTable::restrictBounds(std::vector<robot_model::JointModel::Bounds> &bounds) const
+{
+  for (std::size_t i = 0 ; i < entries_.size() ; ++i)
+  {
+    const Entry &e = entries_[i];
+    if (e.joint >= bounds.size() || bounds[e.joint].size() != 1)
+      continue;
+    robot_model::VariableBounds &b = bounds[e.joint][0];
+    double lo = std::max(b.min_position_, e.position + e.below);
+    double hi = std::min(b.max_position_, e.position + e.above);
+    if (lo > hi)
+    {
+      ROS_WARN("Joint path constraint on '%s' does not intersect the joint bounds", jmg_->getActiveJointModels()[e.joint]->getName().c_str());
+      continue;
+    }
+    b.min_position_ = lo;
+    b.max_position_ = hi;
+    b.position_bounded_ = true;
+  }
+}
@@ -0,0 +1,75 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/joint_space_nearest_neighbors.h"
+
+namespace
+{
+thread_local const ompl_interface::JointSpaceMetric *current_metric = NULL;
+}
+
+bool ompl_interface::JointSpaceMetric::configure(const robot_model::JointModelGroup *jmg)
+{
+  index.clear();
+  weight.clear();
+  wrap.clear();
+
+  const std::vector<const robot_model::JointModel*> &joints = jmg->getActiveJointModels();
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+  {
+    const robot_model::JointModel *jm = joints[i];
+    if (jm->getVariableCount() != 1 ||
+        (jm->getType() != robot_model::JointModel::REVOLUTE && jm->getType() != robot_model::JointModel::PRISMATIC))
+      return false;
+    index.push_back(jmg->getVariableGroupIndex(jm->getName()));
+    weight.push_back(jm->getDistanceFactor());
+    wrap.push_back(jm->getType() == robot_model::JointModel::REVOLUTE && static_cast<const robot_model::RevoluteJointModel*>(jm)->isContinuous());
+  }
+  return !index.empty() && index.size() <= MAX_DIMENSION;
+}
+
+ompl_interface::JointSpaceMetric::Scope::Scope(const JointSpaceMetric *metric) : previous_(current_metric)
+{
+  current_metric = metric;
+}
+
+ompl_interface::JointSpaceMetric::Scope::~Scope()
+{
+  current_metric = previous_;
+}
+
+const ompl_interface::JointSpaceMetric* ompl_interface::JointSpaceMetric::getCurrent()
+{
+  return current_metric;
+}
@@ -0,0 +1,357 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/reachability_map.h"
+#include <moveit/robot_state/robot_state.h>
+#include <eigen_conversions/eigen_msg.h>
+#include <random_numbers/random_numbers.h>
+#include <ros/console.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+const char MAP_FILE_MAGIC[4] = { 'R', 'M', 'A', 'P' };
+const boost::uint32_t MAP_FILE_VERSION = 1;
+// written in native byte order; read back as a different value on a machine with another byte order
+const boost::uint32_t MAP_FILE_BYTE_ORDER = 0x01020304;
+
+template<typename T>
+void writeValue(std::ostream &out, const T &value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<typename T>
+bool readValue(std::istream &in, T &value)
+{
+  return in.read(reinterpret_cast<char*>(&value), sizeof(value)).good();
+}
+
+void writeString(std::ostream &out, const std::string &str)
+{
+  writeValue<boost::uint32_t>(out, str.size());
+  out.write(str.data(), str.size());
+}
+
+bool readString(std::istream &in, std::string &str)
+{
+  boost::uint32_t length;
+  if (!readValue(in, length) || length > (1 << 16))
+    return false;
+  str.resize(length);
+  return length == 0 || in.read(&str[0], length).good();
+}
+
+std::string stripLeadingSlash(const std::string &frame)
+{
+  return !frame.empty() && frame[0] == '/' ? frame.substr(1) : frame;
+}
+
+// sqrt(det(J J^T)), or sqrt(det(J^T J)) for groups with fewer joints than task space dimensions
+double computeManipulability(const Eigen::MatrixXd &jacobian)
+{
+  double det = jacobian.rows() <= jacobian.cols() ?
+    (jacobian * jacobian.transpose()).determinant() : (jacobian.transpose() * jacobian).determinant();
+  return det > 0.0 ? std::sqrt(det) : 0.0;
+}
+}
+
+ompl_interface::ReachabilityMap::ReachabilityMap()
+  : resolution_(0.0)
+  , origin_(Eigen::Vector3d::Zero())
+  , max_manipulability_(0.0f)
+{
+  size_[0] = size_[1] = size_[2] = 0;
+}
+
+bool ompl_interface::ReachabilityMap::build(const robot_model::RobotModelConstPtr &model, const std::string &group, double resolution,
+                                            unsigned int samples, unsigned int ik_checks)
+{
+  const robot_model::JointModelGroup *jmg = model->getJointModelGroup(group);
+  if (!jmg || resolution <= 0.0 || samples == 0)
+  {
+    ROS_ERROR("Cannot build a reachability map for group '%s'", group.c_str());
+    return false;
+  }
+
+  // poses are expressed in the frames of the kinematics solver, so they can be passed to it directly
+  const robot_model::JointModelGroup::KinematicsSolver &solver = jmg->getGroupKinematics().first;
+  std::shared_ptr<kinematics::KinematicsBase> ik;
+  if (solver)
+    ik = solver.allocator_(jmg);
+  if (ik)
+  {
+    base_frame_ = stripLeadingSlash(ik->getBaseFrame());
+    tip_frame_ = stripLeadingSlash(ik->getTipFrame());
+  }
+  else
+  {
+    const robot_model::LinkModel *parent = jmg->getJointModels().front()->getParentLinkModel();
+    base_frame_ = parent ? parent->getName() : model->getRootLinkName();
+    tip_frame_ = jmg->getLinkModels().back()->getName();
+  }
+  if (!model->hasLinkModel(base_frame_) || !model->hasLinkModel(tip_frame_))
+  {
+    ROS_ERROR("Frames '%s' and '%s' of group '%s' are not links of the robot model", base_frame_.c_str(), tip_frame_.c_str(), group.c_str());
+    return false;
+  }
+  const robot_model::LinkModel *base_link = model->getLinkModel(base_frame_);
+  const robot_model::LinkModel *tip_link = model->getLinkModel(tip_frame_);
+  group_ = group;
+  resolution_ = resolution;
+
+  // sample the workspace
+  random_numbers::RandomNumberGenerator rng;
+  robot_state::RobotState state(model);
+  state.setToDefaultValues();
+  std::vector<Eigen::Affine3d, Eigen::aligned_allocator<Eigen::Affine3d> > poses(samples);
+  std::vector<double> manipulability(samples, 0.0);
+  Eigen::MatrixXd jacobian;
+  for (unsigned int i = 0 ; i < samples ; ++i)
+  {
+    state.setToRandomPositions(jmg, rng);
+    state.updateLinkTransforms();
+    poses[i] = state.getGlobalLinkTransform(base_link).inverse(Eigen::Isometry) * state.getGlobalLinkTransform(tip_link);
+    if (state.getJacobian(jmg, tip_link, Eigen::Vector3d::Zero(), jacobian))
+      manipulability[i] = computeManipulability(jacobian);
+  }
+
+  // the grid covers all reached positions
+  Eigen::Vector3d low = poses[0].translation();
+  Eigen::Vector3d high = low;
+  for (unsigned int i = 1 ; i < samples ; ++i)
+  {
+    low = low.cwiseMin(poses[i].translation());
+    high = high.cwiseMax(poses[i].translation());
+  }
+  origin_ = low;
+  for (int k = 0 ; k < 3 ; ++k)
+    size_[k] = (int)std::floor((high[k] - low[k]) / resolution_) + 1;
+  cells_.clear();
+  cells_.resize((std::size_t)size_[0] * size_[1] * size_[2]);
+  memset(&cells_[0], 0, cells_.size() * sizeof(Cell));
+
+  max_manipulability_ = 0.0f;
+  for (unsigned int i = 0 ; i < samples ; ++i)
+  {
+    int index[3];
+    getIndex(poses[i].translation(), index);
+    Cell &cell = cells_[((std::size_t)index[2] * size_[1] + index[1]) * size_[0] + index[0]];
+    cell.samples++;
+    cell.orientations |= 1u << getOrientationBin(poses[i]);
+    cell.manipulability += (manipulability[i] - cell.manipulability) / cell.samples;
+  }
+  for (std::size_t i = 0 ; i < cells_.size() ; ++i)
+    max_manipulability_ = std::max(max_manipulability_, cells_[i].manipulability);
+
+  // IK success rate, for reachable poses and random seeds
+  if (ik && ik_checks > 0)
+  {
+    std::vector<double> group_values;
+    std::vector<double> seed(solver.bijection_.size());
+    std::vector<double> solution;
+    for (unsigned int i = 0 ; i < std::min(ik_checks, samples) ; ++i)
+    {
+      state.setToRandomPositions(jmg, rng);
+      state.copyJointGroupPositions(jmg, group_values);
+      for (std::size_t j = 0 ; j < solver.bijection_.size() ; ++j)
+        seed[j] = group_values[solver.bijection_[j]];
+
+      geometry_msgs::Pose pose;
+      tf::poseEigenToMsg(poses[i], pose);
+      moveit_msgs::MoveItErrorCodes error_code;
+      int index[3];
+      getIndex(poses[i].translation(), index);
+      Cell &cell = cells_[((std::size_t)index[2] * size_[1] + index[1]) * size_[0] + index[0]];
+      cell.ik_attempts++;
+      if (ik->getPositionIK(pose, seed, solution, error_code))
+        cell.ik_successes++;
+    }
+  }
+
+  std::size_t occupied = 0;
+  for (std::size_t i = 0 ; i < cells_.size() ; ++i)
+    if (cells_[i].samples > 0)
+      occupied++;
+  ROS_INFO("Reachability map of '%s': %d x %d x %d voxels of %f m, %lu reached", group_.c_str(), size_[0], size_[1], size_[2],
+           resolution_, occupied);
+  return true;
+}
+
+bool ompl_interface::ReachabilityMap::save(const std::string &filename) const
+{
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if (!out.good())
+  {
+    ROS_ERROR("Unable to open '%s' for writing", filename.c_str());
+    return false;
+  }
+  out.write(MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC));
+  writeValue(out, MAP_FILE_VERSION);
+  writeValue(out, MAP_FILE_BYTE_ORDER);
+  writeString(out, group_);
+  writeString(out, base_frame_);
+  writeString(out, tip_frame_);
+  writeValue(out, resolution_);
+  for (int k = 0 ; k < 3 ; ++k)
+    writeValue(out, origin_[k]);
+  for (int k = 0 ; k < 3 ; ++k)
+    writeValue<boost::int32_t>(out, size_[k]);
+  writeValue(out, max_manipulability_);
+  if (!cells_.empty())
+    out.write(reinterpret_cast<const char*>(&cells_[0]), cells_.size() * sizeof(Cell));
+  return out.good();
+}
+
+bool ompl_interface::ReachabilityMap::load(const std::string &filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  char magic[sizeof(MAP_FILE_MAGIC)];
+  boost::uint32_t version, byte_order;
+  if (!in.good() || !in.read(magic, sizeof(magic)).good() || memcmp(magic, MAP_FILE_MAGIC, sizeof(magic)) != 0 ||
+      !readValue(in, version) || version != MAP_FILE_VERSION || !readValue(in, byte_order) || byte_order != MAP_FILE_BYTE_ORDER)
+  {
+    ROS_ERROR("'%s' is not a reachability map of this version and byte order", filename.c_str());
+    return false;
+  }
+
+  boost::int32_t size[3];
+  if (!readString(in, group_) || !readString(in, base_frame_) || !readString(in, tip_frame_) || !readValue(in, resolution_) ||
+      !readValue(in, origin_[0]) || !readValue(in, origin_[1]) || !readValue(in, origin_[2]) ||
+      !readValue(in, size[0]) || !readValue(in, size[1]) || !readValue(in, size[2]) || !readValue(in, max_manipulability_) ||
+      size[0] <= 0 || size[1] <= 0 || size[2] <= 0 || resolution_ <= 0.0)
+  {
+    ROS_ERROR("Corrupt reachability map header in '%s'", filename.c_str());
+    cells_.clear();
+    return false;
+  }
+  for (int k = 0 ; k < 3 ; ++k)
+    size_[k] = size[k];
+
+  cells_.resize((std::size_t)size_[0] * size_[1] * size_[2]);
+  if (!in.read(reinterpret_cast<char*>(&cells_[0]), cells_.size() * sizeof(Cell)).good())
+  {
+    ROS_ERROR("Truncated reachability map '%s'", filename.c_str());
+    cells_.clear();
+    return false;
+  }
+  return true;
+}
+
+bool ompl_interface::ReachabilityMap::getIndex(const Eigen::Vector3d &position, int index[3]) const
+{
+  for (int k = 0 ; k < 3 ; ++k)
+  {
+    index[k] = (int)std::floor((position[k] - origin_[k]) / resolution_);
+    if (index[k] < 0 || index[k] >= size_[k])
+      return false;
+  }
+  return true;
+}
+
+const ompl_interface::ReachabilityMap::Cell* ompl_interface::ReachabilityMap::getCell(const Eigen::Vector3d &position) const
+{
+  int index[3];
+  if (cells_.empty() || !getIndex(position, index))
+    return NULL;
+  return &cells_[((std::size_t)index[2] * size_[1] + index[1]) * size_[0] + index[0]];
+}
+
+bool ompl_interface::ReachabilityMap::isReachable(const Eigen::Affine3d &pose) const
+{
+  const Cell *cell = getCell(pose.translation());
+  return cell && (cell->orientations & (1u << getOrientationBin(pose)));
+}
+
+bool ompl_interface::ReachabilityMap::getIndexRange(const Eigen::Vector3d &min, const Eigen::Vector3d &max,
+                                                    int low[3], int high[3]) const
+{
+  if (cells_.empty())
+    return false;
+  for (int k = 0 ; k < 3 ; ++k)
+  {
+    low[k] = std::max(0, (int)std::floor((min[k] - origin_[k]) / resolution_));
+    high[k] = std::min(size_[k] - 1, (int)std::floor((max[k] - origin_[k]) / resolution_));
+    if (low[k] > high[k])
+      return false;
+  }
+  return true;
+}
+
+bool ompl_interface::ReachabilityMap::isRegionInside(const Eigen::Vector3d &min, const Eigen::Vector3d &max) const
+{
+  int low[3], high[3];
+  return getIndexRange(min, max, low, high);
+}
+
+bool ompl_interface::ReachabilityMap::isRegionReachable(const Eigen::Vector3d &min, const Eigen::Vector3d &max) const
+{
+  int low[3], high[3];
+  if (!getIndexRange(min, max, low, high))
+    return false;
+  for (int z = low[2] ; z <= high[2] ; ++z)
+    for (int y = low[1] ; y <= high[1] ; ++y)
+      for (int x = low[0] ; x <= high[0] ; ++x)
+        if (cells_[((std::size_t)z * size_[1] + y) * size_[0] + x].samples > 0)
+          return true;
+  return false;
+}
+
+double ompl_interface::ReachabilityMap::getScore(const Eigen::Affine3d &pose) const
+{
+  const Cell *cell = getCell(pose.translation());
+  if (!cell || !(cell->orientations & (1u << getOrientationBin(pose))))
+    return 0.0;
+  double ik_rate = cell->ik_attempts > 0 ? (double)cell->ik_successes / (double)cell->ik_attempts : 1.0;
+  double manipulability = max_manipulability_ > 0.0f ? cell->manipulability / max_manipulability_ : 1.0;
+  return ik_rate * manipulability;
+}
+
+unsigned int ompl_interface::ReachabilityMap::getOrientationBin(const Eigen::Affine3d &pose)
+{
+  // the face of the cube map is the dominant axis of the approach direction and its sign;
+  // the bin within the face is given by the signs of the other two components
+  const Eigen::Vector3d approach = pose.linear().col(2);
+  int axis = 0;
+  for (int k = 1 ; k < 3 ; ++k)
+    if (std::fabs(approach[k]) > std::fabs(approach[axis]))
+      axis = k;
+  unsigned int face = axis * 2 + (approach[axis] < 0.0 ? 1 : 0);
+  unsigned int quadrant = (approach[(axis + 1) % 3] < 0.0 ? 1 : 0) + (approach[(axis + 2) % 3] < 0.0 ? 2 : 0);
+  return face * 4 + quadrant;
+}
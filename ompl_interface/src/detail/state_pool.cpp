@@ -0,0 +1,218 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/state_pool.h"
+#include <algorithm>
+
+namespace
+{
+// Blocks are aligned (and padded) to this many bytes
+const std::size_t BLOCK_ALIGNMENT = 16;
+
+// Every block is preceded by a header of this size, which holds the index of its shard and
+// of its chunk within the shard.  The header keeps the blocks aligned.
+const std::size_t BLOCK_HEADER_SIZE = BLOCK_ALIGNMENT;
+
+struct BlockHeader
+{
+  unsigned int shard;
+  unsigned int chunk;
+};
+
+inline BlockHeader* getHeader(void *block)
+{
+  return reinterpret_cast<BlockHeader*>(static_cast<char*>(block) - BLOCK_HEADER_SIZE);
+}
+
+boost::atomic<unsigned int> thread_count(0);
+
+// The shard index of the calling thread, assigned round robin on first use
+unsigned int getThreadIndex()
+{
+  static thread_local unsigned int index = thread_count++;
+  return index;
+}
+
+std::size_t alignBlockSize(std::size_t size)
+{
+  if (size < sizeof(void*))
+    size = sizeof(void*);
+  return (size + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+}
+}
+
+ompl_interface::StatePool::StatePool(std::size_t block_size, std::size_t blocks_per_chunk)
+  : block_size_(alignBlockSize(block_size))
+  , blocks_per_chunk_(blocks_per_chunk > 0 ? blocks_per_chunk : 1)
+  , in_use_(0)
+  , peak_in_use_(0)
+{
+}
+
+ompl_interface::StatePool::~StatePool()
+{
+  freeChunks();
+}
+
+void* ompl_interface::StatePool::allocate()
+{
+  unsigned int index = getThreadIndex() % SHARD_COUNT;
+  Shard &shard = shards_[index];
+  void *block;
+  {
+    boost::mutex::scoped_lock slock(shard.lock);
+    if (!shard.free_list)
+    {
+      // carve a new chunk into blocks, each preceded by a header naming this shard and the chunk;
+      // the slot of a chunk released by trim() is reused
+      std::size_t stride = BLOCK_HEADER_SIZE + block_size_;
+      char *chunk = new char[stride * blocks_per_chunk_];
+      std::size_t c = std::find(shard.chunks.begin(), shard.chunks.end(), static_cast<char*>(NULL)) - shard.chunks.begin();
+      if (c == shard.chunks.size())
+      {
+        shard.chunks.push_back(chunk);
+        shard.chunk_blocks_in_use.push_back(0);
+      }
+      else
+        shard.chunks[c] = chunk;
+      for (std::size_t i = blocks_per_chunk_ ; i > 0 ; --i)
+      {
+        BlockHeader *header = reinterpret_cast<BlockHeader*>(chunk + (i - 1) * stride);
+        header->shard = index;
+        header->chunk = c;
+        void *b = reinterpret_cast<char*>(header) + BLOCK_HEADER_SIZE;
+        *static_cast<void**>(b) = shard.free_list;
+        shard.free_list = b;
+      }
+    }
+    block = shard.free_list;
+    shard.free_list = *static_cast<void**>(block);
+    ++shard.chunk_blocks_in_use[getHeader(block)->chunk];
+  }
+  std::size_t used = ++in_use_;
+  std::size_t peak = peak_in_use_.load(boost::memory_order_relaxed);
+  while (used > peak && !peak_in_use_.compare_exchange_weak(peak, used, boost::memory_order_relaxed))
+    ;
+  return block;
+}
+
+void ompl_interface::StatePool::free(void *block)
+{
+  // the block goes back to the shard it was carved from, whichever thread frees it
+  const BlockHeader *header = getHeader(block);
+  Shard &shard = shards_[header->shard];
+  {
+    boost::mutex::scoped_lock slock(shard.lock);
+    --shard.chunk_blocks_in_use[header->chunk];
+    *static_cast<void**>(block) = shard.free_list;
+    shard.free_list = block;
+  }
+  --in_use_;
+}
+
+bool ompl_interface::StatePool::release()
+{
+  if (in_use_ > 0)
+    return false;
+  freeChunks();
+  return true;
+}
+
+std::size_t ompl_interface::StatePool::trim()
+{
+  std::size_t released = 0;
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+  {
+    Shard &shard = shards_[i];
+    boost::mutex::scoped_lock slock(shard.lock);
+    std::vector<bool> unused(shard.chunks.size(), false);
+    bool any = false;
+    for (std::size_t c = 0 ; c < shard.chunks.size() ; ++c)
+      if (shard.chunks[c] && shard.chunk_blocks_in_use[c] == 0)
+        unused[c] = any = true;
+    if (!any)
+      continue;
+
+    // unlink the blocks of the unused chunks from the free list, then free the chunks
+    void **link = &shard.free_list;
+    while (*link)
+      if (unused[getHeader(*link)->chunk])
+        *link = *static_cast<void**>(*link);
+      else
+        link = static_cast<void**>(*link);
+    for (std::size_t c = 0 ; c < shard.chunks.size() ; ++c)
+      if (unused[c])
+      {
+        delete[] shard.chunks[c];
+        shard.chunks[c] = NULL;
+        released += blocks_per_chunk_ * (BLOCK_HEADER_SIZE + block_size_);
+      }
+  }
+  return released;
+}
+
+bool ompl_interface::StatePool::setBlockSize(std::size_t block_size)
+{
+  block_size = alignBlockSize(block_size);
+  if (block_size == block_size_)
+    return true;
+  if (!release())
+    return false;
+  block_size_ = block_size;
+  return true;
+}
+
+std::size_t ompl_interface::StatePool::getReservedMemory() const
+{
+  std::size_t chunks = 0;
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+  {
+    boost::mutex::scoped_lock slock(shards_[i].lock);
+    chunks += shards_[i].chunks.size() - std::count(shards_[i].chunks.begin(), shards_[i].chunks.end(), static_cast<char*>(NULL));
+  }
+  return chunks * blocks_per_chunk_ * (BLOCK_HEADER_SIZE + block_size_);
+}
+
+void ompl_interface::StatePool::freeChunks()
+{
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+  {
+    boost::mutex::scoped_lock slock(shards_[i].lock);
+    for (std::size_t j = 0 ; j < shards_[i].chunks.size() ; ++j)
+      delete[] shards_[i].chunks[j];
+    shards_[i].chunks.clear();
+    shards_[i].chunk_blocks_in_use.clear();
+    shards_[i].free_list = NULL;
+  }
+}
@@ -36,8 +36,23 @@
 
 #include "moveit/ompl_interface/detail/state_validity_checker.h"
 #include "moveit/ompl_interface/ompl_planning_context.h"
-#include <moveit/profiler/profiler.h>
 #include <ros/ros.h>
+#include <boost/atomic.hpp>
+
+namespace
+{
+boost::atomic<unsigned long> checker_count(0);
+
+#ifdef MOVEIT_OMPL_INTERFACE_VALIDITY_STATISTICS
+// Statistics of the checker most recently used by this thread; avoids locking on every check
+struct ThreadStatisticsCache
+{
+  unsigned long owner;
+  ompl_interface::StateValidityStatistics *stats;
+};
+thread_local ThreadStatisticsCache thread_statistics_cache = { 0, NULL };
+#endif
+}
 
 ompl_interface::StateValidityChecker::StateValidityChecker(const OMPLPlanningContext *pc)
   : ompl::base::StateValidityChecker(pc->getOMPLSpaceInformation())
@@ -45,6 +60,9 @@ ompl_interface::StateValidityChecker::StateValidityChecker(const OMPLPlanningCon
   , group_name_(pc->getGroupName())
   , tss_(pc->getCompleteInitialRobotState())
   , verbose_(false)
+  , combined_evaluation_(false)
+  , joint_path_constraints_(pc->getJointPathConstraints())
+  , id_(++checker_count)
 {
   specs_.clearanceComputationType = ompl::base::StateValidityCheckerSpecs::APPROXIMATE;
   specs_.hasValidDirectionComputation = false;
@@ -61,6 +79,18 @@ ompl_interface::StateValidityChecker::StateValidityChecker(const OMPLPlanningCon
 
   collision_request_with_distance_verbose_ = collision_request_with_distance_;
   collision_request_with_distance_verbose_.verbose = true;
+
+  collision_request_combined_ = collision_request_with_distance_;
+  collision_request_combined_.cost = true;
+
+  collision_request_combined_verbose_ = collision_request_combined_;
+  collision_request_combined_verbose_.verbose = true;
+}
+
+ompl_interface::StateValidityChecker::~StateValidityChecker()
+{
+  for (std::map<boost::thread::id, StateValidityStatistics*>::iterator it = thread_statistics_.begin() ; it != thread_statistics_.end() ; ++it)
+    delete it->second;
 }
 
 void ompl_interface::StateValidityChecker::setVerbose(bool flag)
@@ -68,100 +98,287 @@ void ompl_interface::StateValidityChecker::setVerbose(bool flag)
   verbose_ = flag;
 }
 
+void ompl_interface::StateValidityChecker::setCombinedEvaluation(bool flag)
+{
+  combined_evaluation_ = flag;
+}
+
+ompl_interface::StateValidityStatistics* ompl_interface::StateValidityChecker::getThreadStatistics() const
+{
+#ifdef MOVEIT_OMPL_INTERFACE_VALIDITY_STATISTICS
+  if (thread_statistics_cache.owner == id_)
+    return thread_statistics_cache.stats;
+
+  StateValidityStatistics *stats = NULL;
+  {
+    boost::mutex::scoped_lock slock(statistics_lock_);
+    std::map<boost::thread::id, StateValidityStatistics*>::const_iterator it = thread_statistics_.find(boost::this_thread::get_id());
+    if (it == thread_statistics_.end())
+    {
+      stats = new StateValidityStatistics();
+      thread_statistics_[boost::this_thread::get_id()] = stats;
+    }
+    else
+      stats = it->second;
+  }
+  thread_statistics_cache.owner = id_;
+  thread_statistics_cache.stats = stats;
+  return stats;
+#else
+  return NULL;
+#endif
+}
+
+void ompl_interface::StateValidityChecker::collectStatistics(StateValidityStatistics &stats, bool reset) const
+{
+  boost::mutex::scoped_lock slock(statistics_lock_);
+  for (std::map<boost::thread::id, StateValidityStatistics*>::const_iterator it = thread_statistics_.begin() ; it != thread_statistics_.end() ; ++it)
+  {
+    stats.merge(*it->second);
+    if (reset)
+      it->second->clear();
+  }
+}
+
+void ompl_interface::StateValidityChecker::getMemoryUsage(MemoryUsageReport &report) const
+{
+  report["robot_states"].update(tss_.getMemoryUsage(), tss_.getStateCount());
+
+  boost::mutex::scoped_lock slock(statistics_lock_);
+  report["validity_statistics"].update(thread_statistics_.size() * sizeof(StateValidityStatistics), thread_statistics_.size());
+}
+
+bool ompl_interface::StateValidityChecker::checkBounds(const ompl::base::State *state, bool verbose, StateValidityStatistics *stats) const
+{
+  ScopedStageTimer timer(stats, StateValidityStatistics::BOUNDS);
+  if (!si_->satisfiesBounds(state))
+  {
+    if (verbose)
+      ROS_INFO("State outside bounds");
+    return false;
+  }
+  return true;
+}
+
+bool ompl_interface::StateValidityChecker::checkJointPathConstraints(const ompl::base::State *state, bool verbose, double *dist,
+                                                                     StateValidityStatistics *stats) const
+{
+  if (!joint_path_constraints_)
+    return true;
+
+  ScopedStageTimer timer(stats, StateValidityStatistics::PATH_CONSTRAINTS);
+  double d;
+  if (joint_path_constraints_->decide(state->as<ModelBasedStateSpace::StateType>()->values, &d))
+    return true;
+  if (verbose)
+    ROS_INFO("State violates joint path constraints");
+  if (dist)
+    *dist = d;
+  return false;
+}
+
+robot_state::RobotState* ompl_interface::StateValidityChecker::getRobotState(const ompl::base::State *state, StateValidityStatistics *stats) const
+{
+  ScopedStageTimer timer(stats, StateValidityStatistics::ROBOT_STATE);
+  robot_state::RobotState *kstate = tss_.getStateStorage();
+  planning_context_->getOMPLStateSpace()->copyToRobotState(*kstate, state);
+  return kstate;
+}
+
+bool ompl_interface::StateValidityChecker::checkPathConstraints(const robot_state::RobotState &kstate, bool verbose, double *dist,
+                                                                StateValidityStatistics *stats) const
+{
+  // joint path constraints are checked on the OMPL state instead
+  const kinematic_constraints::KinematicConstraintSetPtr &kset = planning_context_->getPathConstraints();
+  if (!kset || joint_path_constraints_)
+    return true;
+
+  ScopedStageTimer timer(stats, StateValidityStatistics::PATH_CONSTRAINTS);
+  kinematic_constraints::ConstraintEvaluationResult cer = kset->decide(kstate, verbose);
+  if (dist && !cer.satisfied)
+    *dist = cer.distance;
+  return cer.satisfied;
+}
+
+bool ompl_interface::StateValidityChecker::checkFeasibility(const robot_state::RobotState &kstate, bool verbose, StateValidityStatistics *stats) const
+{
+  ScopedStageTimer timer(stats, StateValidityStatistics::FEASIBILITY);
+  return planning_context_->getPlanningScene()->isStateFeasible(kstate, verbose);
+}
+
+void ompl_interface::StateValidityChecker::checkCollision(const collision_detection::CollisionRequest &req, collision_detection::CollisionResult &res,
+                                                          const robot_state::RobotState &kstate, StateValidityStatistics *stats) const
+{
+  ScopedStageTimer timer(stats, StateValidityStatistics::COLLISION);
+  planning_context_->getPlanningScene()->checkCollision(req, res, kstate);
+}
+
+double ompl_interface::StateValidityChecker::computeCost(const collision_detection::CollisionResult &res)
+{
+  // Calculates cost from a summation of distance to obstacles times the size of the obstacle
+  double cost = 0.0;
+  for (std::set<collision_detection::CostSource>::const_iterator it = res.cost_sources.begin() ; it != res.cost_sources.end() ; ++it)
+    cost += it->cost * it->getVolume();
+  return cost;
+}
+
+bool ompl_interface::StateValidityChecker::evaluate(const ompl::base::State *state, bool verbose, bool with_cost) const
+{
+  ModelBasedStateSpace::StateType *mstate = const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>();
+  StateValidityStatistics *stats = getThreadStatistics();
+
+  if (!checkBounds(state, verbose, stats))
+  {
+    mstate->markInvalid(0.0);
+    return false;
+  }
+
+  // check joint path constraints
+  double dist = 0.0;
+  if (!checkJointPathConstraints(state, verbose, &dist, stats))
+  {
+    mstate->markInvalid(dist);
+    return false;
+  }
+
+  robot_state::RobotState *kstate = getRobotState(state, stats);
+
+  // check path constraints
+  if (!checkPathConstraints(*kstate, verbose, &dist, stats))
+  {
+    mstate->markInvalid(dist);
+    return false;
+  }
+
+  // check feasibility
+  if (!checkFeasibility(*kstate, verbose, stats))
+  {
+    mstate->markInvalid(0.0);
+    return false;
+  }
+
+  // check collision avoidance, computing distance (and cost) with the same query
+  collision_detection::CollisionResult res;
+  if (with_cost)
+  {
+    checkCollision(verbose ? collision_request_combined_verbose_ : collision_request_combined_, res, *kstate, stats);
+    mstate->markCost(computeCost(res));
+  }
+  else
+    checkCollision(verbose ? collision_request_with_distance_verbose_ : collision_request_with_distance_, res, *kstate, stats);
+  if (res.collision == false)
+  {
+    mstate->markValid(res.distance);
+    return true;
+  }
+  mstate->markInvalid(res.distance);
+  return false;
+}
+
 bool ompl_interface::StateValidityChecker::isValid(const ompl::base::State *state, bool verbose) const
 {
-  //  moveit::Profiler::ScopedBlock sblock("isValid");
   return planning_context_->useStateValidityCache() ? isValidWithCache(state, verbose) : isValidWithoutCache(state, verbose);
 }
 
 bool ompl_interface::StateValidityChecker::isValid(const ompl::base::State *state, double &dist, bool verbose) const
 {
-  //  moveit::Profiler::ScopedBlock sblock("isValid");
   return planning_context_->useStateValidityCache() ? isValidWithCache(state, dist, verbose) : isValidWithoutCache(state, dist, verbose);
 }
 
 double ompl_interface::StateValidityChecker::cost(const ompl::base::State *state) const
 {
-  double cost = 0.0;
+  if (planning_context_->useStateValidityCache())
+  {
+    const ModelBasedStateSpace::StateType *mstate = state->as<ModelBasedStateSpace::StateType>();
+    if (mstate->isCostKnown())
+      return mstate->cost;
+    // if the state passes the checks that precede collision checking, this also computes its cost
+    if (!mstate->isValidityKnown())
+      evaluate(state, verbose_, true);
+    if (mstate->isCostKnown())
+      return mstate->cost;
+  }
 
-  robot_state::RobotState *kstate = tss_.getStateStorage();
-  planning_context_->getOMPLStateSpace()->copyToRobotState(*kstate, state);
+  StateValidityStatistics *stats = getThreadStatistics();
+  robot_state::RobotState *kstate = getRobotState(state, stats);
 
-  // Calculates cost from a summation of distance to obstacles times the size of the obstacle
   collision_detection::CollisionResult res;
-  planning_context_->getPlanningScene()->checkCollision(collision_request_with_cost_, res, *kstate);
-
-  for (std::set<collision_detection::CostSource>::const_iterator it = res.cost_sources.begin() ; it != res.cost_sources.end() ; ++it)
-    cost += it->cost * it->getVolume();
+  checkCollision(collision_request_with_cost_, res, *kstate, stats);
+  double cost = computeCost(res);
 
+  if (planning_context_->useStateValidityCache())
+    const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markCost(cost);
   return cost;
 }
 
 double ompl_interface::StateValidityChecker::clearance(const ompl::base::State *state) const
 {
-  robot_state::RobotState *kstate = tss_.getStateStorage();
-  planning_context_->getOMPLStateSpace()->copyToRobotState(*kstate, state);
+  if (planning_context_->useStateValidityCache())
+  {
+    const ModelBasedStateSpace::StateType *mstate = state->as<ModelBasedStateSpace::StateType>();
+    if (!mstate->isValidityKnown())
+      evaluate(state, verbose_, true);
+    // a known cost means the collision query ran, so validity and distance describe the collision result
+    if (mstate->isCostKnown() && mstate->isGoalDistanceKnown())
+      return mstate->isMarkedValid() ? (mstate->distance < 0.0 ? std::numeric_limits<double>::infinity() : mstate->distance) : 0.0;
+  }
+
+  StateValidityStatistics *stats = getThreadStatistics();
+  robot_state::RobotState *kstate = getRobotState(state, stats);
 
   collision_detection::CollisionResult res;
-  planning_context_->getPlanningScene()->checkCollision(collision_request_with_distance_, res, *kstate);
+  checkCollision(collision_request_with_distance_, res, *kstate, stats);
   return res.collision ? 0.0 : (res.distance < 0.0 ? std::numeric_limits<double>::infinity() : res.distance);
 }
 
 bool ompl_interface::StateValidityChecker::isValidWithoutCache(const ompl::base::State *state, bool verbose) const
 {
+  StateValidityStatistics *stats = getThreadStatistics();
+
   // check bounds
-  if (!si_->satisfiesBounds(state))
-  {
-    if (verbose)
-      ROS_INFO("State outside bounds");
+  if (!checkBounds(state, verbose, stats))
+    return false;
+
+  // check joint path constraints
+  if (!checkJointPathConstraints(state, verbose, NULL, stats))
     return false;
-  }
 
   // convert ompl state to moveit robot state
-  robot_state::RobotState *kstate = tss_.getStateStorage();
-  planning_context_->getOMPLStateSpace()->copyToRobotState(*kstate, state);
+  robot_state::RobotState *kstate = getRobotState(state, stats);
 
   // check path constraints
-  const kinematic_constraints::KinematicConstraintSetPtr &kset = planning_context_->getPathConstraints();
-  if (kset && !kset->decide(*kstate, verbose).satisfied)
-   return false;
+  if (!checkPathConstraints(*kstate, verbose, NULL, stats))
+    return false;
 
   // check feasibility
-  if (!planning_context_->getPlanningScene()->isStateFeasible(*kstate, verbose))
+  if (!checkFeasibility(*kstate, verbose, stats))
     return false;
 
   // check collision avoidance
   collision_detection::CollisionResult res;
-  planning_context_->getPlanningScene()->checkCollision(verbose ? collision_request_simple_verbose_ : collision_request_simple_, res, *kstate);
+  checkCollision(verbose ? collision_request_simple_verbose_ : collision_request_simple_, res, *kstate, stats);
   return res.collision == false;
 }
 
 bool ompl_interface::StateValidityChecker::isValidWithoutCache(const ompl::base::State *state, double &dist, bool verbose) const
 {
-  if (!si_->satisfiesBounds(state))
-  {
-    if (verbose)
-      ROS_INFO("State outside bounds");
+  StateValidityStatistics *stats = getThreadStatistics();
+
+  if (!checkBounds(state, verbose, stats))
     return false;
-  }
 
-  robot_state::RobotState *kstate = tss_.getStateStorage();
-  planning_context_->getOMPLStateSpace()->copyToRobotState(*kstate, state);
+  // check joint path constraints
+  if (!checkJointPathConstraints(state, verbose, &dist, stats))
+    return false;
+
+  robot_state::RobotState *kstate = getRobotState(state, stats);
 
   // check path constraints
-  const kinematic_constraints::KinematicConstraintSetPtr &kset = planning_context_->getPathConstraints();
-  if (kset)
-  {
-   kinematic_constraints::ConstraintEvaluationResult cer = kset->decide(*kstate, verbose);
-   if (!cer.satisfied)
-   {
-     dist = cer.distance;
-     return false;
-   }
-  }
+  if (!checkPathConstraints(*kstate, verbose, &dist, stats))
+    return false;
 
   // check feasibility
-  if (!planning_context_->getPlanningScene()->isStateFeasible(*kstate, verbose))
+  if (!checkFeasibility(*kstate, verbose, stats))
   {
     dist = 0.0;
     return false;
@@ -169,37 +386,51 @@ bool ompl_interface::StateValidityChecker::isValidWithoutCache(const ompl::base:
 
   // check collision avoidance
   collision_detection::CollisionResult res;
-  planning_context_->getPlanningScene()->checkCollision(verbose ? collision_request_with_distance_verbose_ : collision_request_with_distance_, res, *kstate);
+  checkCollision(verbose ? collision_request_with_distance_verbose_ : collision_request_with_distance_, res, *kstate, stats);
   dist = res.distance;
   return res.collision == false;
 }
 
 bool ompl_interface::StateValidityChecker::isValidWithCache(const ompl::base::State *state, bool verbose) const
 {
+  StateValidityStatistics *stats = getThreadStatistics();
+
   if (state->as<ModelBasedStateSpace::StateType>()->isValidityKnown())
+  {
+    if (stats)
+      stats->cache_hits++;
     return state->as<ModelBasedStateSpace::StateType>()->isMarkedValid();
+  }
+  if (stats)
+    stats->cache_misses++;
 
-  if (!si_->satisfiesBounds(state))
+  if (combined_evaluation_)
+    return evaluate(state, verbose, true);
+
+  if (!checkBounds(state, verbose, stats))
   {
-    if (verbose)
-      ROS_INFO("State outside bounds");
     const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markInvalid();
     return false;
   }
 
-  robot_state::RobotState *kstate = tss_.getStateStorage();
-  planning_context_->getOMPLStateSpace()->copyToRobotState(*kstate, state);
+  // check joint path constraints
+  if (!checkJointPathConstraints(state, verbose, NULL, stats))
+  {
+    const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markInvalid();
+    return false;
+  }
+
+  robot_state::RobotState *kstate = getRobotState(state, stats);
 
   // check path constraints
-  const kinematic_constraints::KinematicConstraintSetPtr &kset = planning_context_->getPathConstraints();
-  if (kset && !kset->decide(*kstate, verbose).satisfied)
+  if (!checkPathConstraints(*kstate, verbose, NULL, stats))
   {
    const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markInvalid();
    return false;
   }
 
   // check feasibility
-  if (!planning_context_->getPlanningScene()->isStateFeasible(*kstate, verbose))
+  if (!checkFeasibility(*kstate, verbose, stats))
   {
     const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markInvalid();
     return false;
@@ -207,7 +438,7 @@ bool ompl_interface::StateValidityChecker::isValidWithCache(const ompl::base::St
 
   // check collision avoidance
   collision_detection::CollisionResult res;
-  planning_context_->getPlanningScene()->checkCollision(verbose ? collision_request_simple_verbose_ : collision_request_simple_, res, *kstate);
+  checkCollision(verbose ? collision_request_simple_verbose_ : collision_request_simple_, res, *kstate, stats);
   if (res.collision == false)
   {
     const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markValid();
@@ -224,44 +455,19 @@ bool ompl_interface::StateValidityChecker::isValidWithCache(const ompl::base::St
 {
   if (state->as<ModelBasedStateSpace::StateType>()->isValidityKnown() && state->as<ModelBasedStateSpace::StateType>()->isGoalDistanceKnown())
   {
+    StateValidityStatistics *stats = getThreadStatistics();
+    if (stats)
+      stats->cache_hits++;
     dist = state->as<ModelBasedStateSpace::StateType>()->distance;
     return state->as<ModelBasedStateSpace::StateType>()->isMarkedValid();
   }
 
-  if (!si_->satisfiesBounds(state))
-  {
-    if (verbose)
-      ROS_INFO("State outside bounds");
-    const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markInvalid(0.0);
-    return false;
-  }
-
-  robot_state::RobotState *kstate = tss_.getStateStorage();
-  planning_context_->getOMPLStateSpace()->copyToRobotState(*kstate, state);
-
-  // check path constraints
-  const kinematic_constraints::KinematicConstraintSetPtr &kset = planning_context_->getPathConstraints();
-  if (kset)
-  {
-   kinematic_constraints::ConstraintEvaluationResult cer = kset->decide(*kstate, verbose);
-   if (!cer.satisfied)
-   {
-     dist = cer.distance;
-     const_cast<ompl::base::State*>(state)->as<ModelBasedStateSpace::StateType>()->markInvalid(dist);
-     return false;
-   }
-  }
-
-  // check feasibility
-  if (!planning_context_->getPlanningScene()->isStateFeasible(*kstate, verbose))
-  {
-    dist = 0.0;
-    return false;
-  }
-
-  // check collision avoidance
-  collision_detection::CollisionResult res;
-  planning_context_->getPlanningScene()->checkCollision(verbose ? collision_request_with_distance_verbose_ : collision_request_with_distance_, res, *kstate);
-  dist = res.distance;
-  return res.collision == false;
+  // every outcome (bounds, constraints, feasibility and collision) is stored with the state
+  StateValidityStatistics *stats = getThreadStatistics();
+  if (stats)
+    stats->cache_misses++;
+  // the cost is only computed along if the planner uses it
+  bool valid = evaluate(state, verbose, combined_evaluation_);
+  dist = state->as<ModelBasedStateSpace::StateType>()->distance;
+  return valid;
 }
@@ -35,33 +35,100 @@
 /* Author: Ioan Sucan */
 
 #include <moveit/ompl_interface/detail/threadsafe_state_storage.h>
+#include <boost/atomic.hpp>
 
-ompl_interface::TSStateStorage::TSStateStorage(const robot_model::RobotModelPtr &kmodel) : start_state_(kmodel)
+namespace
+{
+boost::atomic<unsigned long> storage_count(0);
+
+// Direct mapped cache of the states this thread uses, keyed by the id of the storage.
+// Ids are never reused, so entries of destroyed storages are never matched again.
+const unsigned int THREAD_CACHE_SIZE = 16;
+struct ThreadCacheEntry
+{
+  unsigned long            id;
+  robot_state::RobotState *state;
+};
+thread_local ThreadCacheEntry thread_cache[THREAD_CACHE_SIZE];
+
+// Lives as long as the thread; storages hold weak references to it to detect when the thread exits
+thread_local std::shared_ptr<void> thread_token;
+
+const std::shared_ptr<void>& getThreadToken()
+{
+  if (!thread_token)
+    thread_token = std::make_shared<char>(0);
+  return thread_token;
+}
+}
+
+ompl_interface::TSStateStorage::TSStateStorage(const robot_model::RobotModelPtr &kmodel) : start_state_(kmodel), id_(++storage_count)
 {
   start_state_.setToDefaultValues();
 }
 
-ompl_interface::TSStateStorage::TSStateStorage(const robot_state::RobotState &start_state) : start_state_(start_state)
+ompl_interface::TSStateStorage::TSStateStorage(const robot_state::RobotState &start_state) : start_state_(start_state), id_(++storage_count)
 {
 }
 
 ompl_interface::TSStateStorage::~TSStateStorage()
 {
-  for (std::map<boost::thread::id, robot_state::RobotState*>::iterator it = thread_states_.begin() ; it != thread_states_.end() ; ++it)
-    delete it->second;
+  for (std::size_t i = 0 ; i < slots_.size() ; ++i)
+    delete slots_[i].state;
 }
 
 robot_state::RobotState* ompl_interface::TSStateStorage::getStateStorage() const
 {
-  robot_state::RobotState *st = NULL;
-  boost::mutex::scoped_lock slock(lock_);/// \todo use Thread Local Storage?
-  std::map<boost::thread::id, robot_state::RobotState*>::const_iterator it = thread_states_.find(boost::this_thread::get_id());
-  if (it == thread_states_.end())
+  ThreadCacheEntry &entry = thread_cache[id_ % THREAD_CACHE_SIZE];
+  if (entry.id != id_)
   {
-    st = new robot_state::RobotState(start_state_);
-    thread_states_[boost::this_thread::get_id()] = st;
+    entry.state = allocStateStorage();
+    entry.id = id_;
   }
-  else
-    st = it->second;
-  return st;
+  return entry.state;
+}
+
+robot_state::RobotState* ompl_interface::TSStateStorage::allocStateStorage() const
+{
+  const std::shared_ptr<void> &token = getThreadToken();
+  boost::mutex::scoped_lock slock(lock_);
+
+  // the state may already be assigned to this thread, if the cache entry was evicted
+  std::size_t free_slot = slots_.size();
+  for (std::size_t i = 0 ; i < slots_.size() ; ++i)
+  {
+    if (!slots_[i].owner.owner_before(token) && !token.owner_before(slots_[i].owner))
+      return slots_[i].state;
+    if (free_slot == slots_.size() && slots_[i].owner.expired())
+      free_slot = i;
+  }
+
+  // reuse the state of a thread that has exited
+  if (free_slot < slots_.size())
+  {
+    slots_[free_slot].owner = token;
+    return slots_[free_slot].state;
+  }
+
+  Slot slot;
+  slot.owner = token;
+  slot.state = new robot_state::RobotState(start_state_);
+  slots_.push_back(slot);
+  return slot.state;
+}
+
+std::size_t ompl_interface::TSStateStorage::getStateCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return slots_.size();
+}
+
+std::size_t ompl_interface::TSStateStorage::getMemoryUsage() const
+{
+  const robot_model::RobotModelConstPtr &model = start_state_.getRobotModel();
+  // positions, velocities and accelerations; transforms of links, joints and collision bodies
+  const std::size_t state_size = sizeof(robot_state::RobotState) +
+    3 * model->getVariableCount() * sizeof(double) +
+    (model->getLinkModelCount() + model->getJointModelCount() + model->getLinkGeometryCount()) * sizeof(Eigen::Affine3d);
+  return getStateCount() * state_size;
 }
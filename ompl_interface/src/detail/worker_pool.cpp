@@ -0,0 +1,126 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/detail/worker_pool.h"
+
+ompl_interface::WorkerPool::WorkerPool(unsigned int thread_count) : stop_(false)
+{
+  for (unsigned int i = 0 ; i < thread_count ; ++i)
+    threads_.create_thread(boost::bind(&WorkerPool::worker, this));
+}
+
+ompl_interface::WorkerPool::~WorkerPool()
+{
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    stop_ = true;
+  }
+  work_available_.notify_all();
+  threads_.join_all();
+}
+
+void ompl_interface::WorkerPool::run(unsigned int count, const Task &task)
+{
+  if (count == 0)
+    return;
+  if (count == 1 || threads_.size() == 0)
+  {
+    for (unsigned int i = 0 ; i < count ; ++i)
+      task(i);
+    return;
+  }
+
+  Job job;
+  job.task = &task;
+  job.count = count;
+  job.next = 0;
+  job.done = 0;
+
+  boost::mutex::scoped_lock slock(lock_);
+  jobs_.push_back(&job);
+  work_available_.notify_all();
+
+  // help with the queued jobs (ours, or jobs queued before it) until all iterations of ours are taken
+  while (job.next < job.count)
+  {
+    Job *j;
+    unsigned int index;
+    if (!claim(j, index))
+      break;
+    slock.unlock();
+    execute(j, index);
+    slock.lock();
+  }
+
+  // workers hold no reference to the job once its last iteration is done
+  while (job.done < job.count)
+    work_done_.wait(slock);
+}
+
+bool ompl_interface::WorkerPool::claim(Job *&job, unsigned int &index)
+{
+  if (jobs_.empty())
+    return false;
+  job = jobs_.front();
+  index = job->next++;
+  if (job->next == job->count)
+    jobs_.pop_front();
+  return true;
+}
+
+void ompl_interface::WorkerPool::execute(Job *job, unsigned int index)
+{
+  (*job->task)(index);
+  boost::mutex::scoped_lock slock(lock_);
+  if (++job->done == job->count)
+    work_done_.notify_all();
+}
+
+void ompl_interface::WorkerPool::worker()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  while (true)
+  {
+    while (!stop_ && jobs_.empty())
+      work_available_.wait(slock);
+    if (stop_)
+      return;
+    Job *job;
+    unsigned int index;
+    claim(job, index);
+    slock.unlock();
+    execute(job, index);
+    slock.lock();
+  }
+}
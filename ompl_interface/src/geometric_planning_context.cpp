@@ -36,6 +36,7 @@
 
 #include "moveit/ompl_interface/geometric_planning_context.h"
 #include "moveit/ompl_interface/parameterization/joint_space/joint_model_state_space.h"
+#include "moveit/ompl_interface/parameterization/joint_space/fixed_joint_model_state_space.h"
 #include "moveit/ompl_interface/parameterization/work_space/pose_model_state_space.h"
 #include "moveit/ompl_interface/detail/state_validity_checker.h"
 #include "moveit/ompl_interface/detail/projection_evaluators.h"
@@ -47,7 +48,11 @@
 #include <moveit/kinematic_constraints/utils.h>
 #include <eigen_conversions/eigen_msg.h>
 #include <boost/math/constants/constants.hpp>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
+#include <limits>
 
+#include <ompl/base/goals/GoalStates.h>
 #include <ompl/tools/multiplan/ParallelPlan.h>
 #include <ompl/tools/config/SelfConfig.h>
 
@@ -68,6 +73,12 @@
 
 namespace og = ompl::geometric;
 
+namespace
+{
+// Number of samples the background constrained sampling threads can buffer
+const std::size_t CONSTRAINED_SAMPLE_BUFFER_SIZE = 256;
+}
+
 using namespace ompl_interface;
 
 GeometricPlanningContext::GeometricPlanningContext() : OMPLPlanningContext()
@@ -83,12 +94,15 @@ GeometricPlanningContext::GeometricPlanningContext() : OMPLPlanningContext()
 
     // This context is not initialized
     initialized_ = false;
+    unrestricted_extent_ = 0.0;
 
     planner_id_ = "";
 }
 
 GeometricPlanningContext::~GeometricPlanningContext()
 {
+    // The threads of the producer use the initial robot state
+    sample_producer_.reset();
     if (complete_initial_robot_state_)
         delete complete_initial_robot_state_;
 }
@@ -158,6 +172,11 @@ void GeometricPlanningContext::initialize(const std::string& ros_namespace, cons
         spec_.config.erase(it);
 
     OMPLPlanningContext::initialize(ros_namespace, spec_);
+    // The sampling limits were read by the base class; they are not planner parameters
+    spec_.config.erase("max_goal_samples");
+    spec_.config.erase("max_goal_sampling_attempts");
+    spec_.config.erase("max_state_sampling_attempts");
+    spec_.config.erase("goal_sampling_threads");
 
     constraint_sampler_manager_ = spec_.constraint_sampler_mgr;
     if (!complete_initial_robot_state_)
@@ -173,10 +192,18 @@ void GeometricPlanningContext::initialize(const std::string& ros_namespace, cons
     {
         path_constraints_.reset(new kinematic_constraints::KinematicConstraintSet(getRobotModel()));
         path_constraints_->add(request_.path_constraints, getPlanningScene()->getTransforms());
+
+        // Joint-only path constraints are checked directly on the joint values of OMPL states
+        joint_path_constraints_.reset(new JointPathConstraintTable(getRobotModel(), getJointModelGroup(), request_.path_constraints));
+        if (joint_path_constraints_->isValid())
+            ROS_DEBUG("%s: Path constraints compiled into joint intervals", getName().c_str());
+        else
+            joint_path_constraints_.reset();
     }
     else
     {
         path_constraints_.reset();
+        joint_path_constraints_.reset();
     }
 
     // Library of constraints
@@ -192,11 +219,63 @@ void GeometricPlanningContext::initialize(const std::string& ros_namespace, cons
 
     // OMPL StateSpace
     ModelBasedStateSpaceSpecification state_space_spec(spec_.model, spec_.group);
+    // Restrict the joint bounds to the joint path constraints, so sampling only produces states that satisfy them
+    std::vector<robot_model::JointModel::Bounds> constrained_bounds;
+    if (joint_path_constraints_)
+    {
+        const robot_model::JointBoundsVector &bounds = state_space_spec.joint_model_group_->getActiveJointModelsBounds();
+        for (std::size_t i = 0 ; i < bounds.size() ; ++i)
+            constrained_bounds.push_back(*bounds[i]);
+        joint_path_constraints_->restrictBounds(constrained_bounds);
+        for (std::size_t i = 0 ; i < constrained_bounds.size() ; ++i)
+            state_space_spec.joint_bounds_.push_back(&constrained_bounds[i]);
+    }
     allocateStateSpace(state_space_spec);
+    unrestricted_extent_ = mbss_->getMaximumExtent();
+    if (joint_path_constraints_)
+    {
+        // Narrowing the bounds shrinks the extent of the space.  Scale the longest valid segment
+        // fraction so motions are still checked at the resolution of the unrestricted space.
+        unrestricted_extent_ = state_space_spec.joint_model_group_->getMaximumExtent();
+        double extent = mbss_->getMaximumExtent();
+        if (extent > std::numeric_limits<double>::epsilon() && unrestricted_extent_ > extent)
+            mbss_->setLongestValidSegmentFraction(std::min(1.0, mbss_->getLongestValidSegmentFraction() * unrestricted_extent_ / extent));
+    }
+    // The parameters of the state space are not planner parameters
+    spec_.config.erase("pose_jump_factor");
+    spec_.config.erase("pose_minimum_jump");
+    spec_.config.erase("analytic_kinematics");
+
+    // Background sampling of the path constraints.  Only used when the constraints are sampled with a
+    // constraint sampler; joint path constraints are enforced by the bounds of the space.
+    sample_producer_.reset();
+    it = spec_.config.find("constrained_sampling_threads");
+    if (it != spec_.config.end())
+    {
+        unsigned int threads = (unsigned int)boost::lexical_cast<double>(it->second);
+        if (threads > 0 && path_constraints_ && !joint_path_constraints_ && selectPathConstraintSampler())
+        {
+            sample_producer_.reset(new ConstrainedSampleProducer(this, boost::bind(&GeometricPlanningContext::selectPathConstraintSampler, this),
+                                                                 threads, CONSTRAINED_SAMPLE_BUFFER_SIZE));
+            ROS_DEBUG("%s: Sampling path constraints with %u background threads", getName().c_str(), threads);
+        }
+        spec_.config.erase(it);
+    }
+
+    // Nearest neighbor queries of tree planners use a structure specialized for the joint space metric
+    joint_space_metric_.reset(new JointSpaceMetric());
+    if (!std::dynamic_pointer_cast<JointModelStateSpace>(mbss_) || mbss_->getDistanceFunction() ||
+        !joint_space_metric_->configure(mbss_->getJointModelGroup()))
+        joint_space_metric_.reset();
 
     // OMPL SimpleSetup
     simple_setup_.reset(new ompl::geometric::SimpleSetup(mbss_));
 
+    // OMPL MotionValidator.  Segments are checked in bisection order and their validity is cached,
+    // so simplification and hybridization do not check the same segments again.
+    motion_validator_.reset(new BisectionMotionValidator(simple_setup_->getSpaceInformation()));
+    simple_setup_->getSpaceInformation()->setMotionValidator(motion_validator_);
+
     // OMPL ProjectionEvaluator
     it = spec_.config.find("projection_evaluator");
     if (it != spec_.config.end())
@@ -254,16 +333,28 @@ void GeometricPlanningContext::allocateStateSpace(const ModelBasedStateSpaceSpec
             if (ik)
             {
                 PoseModelStateSpacePtr state_space_(new PoseModelStateSpace(state_space_spec));
+                std::map<std::string, std::string>::const_iterator it = spec_.config.find("pose_jump_factor");
+                if (it != spec_.config.end())
+                    state_space_->setJumpFactor(boost::lexical_cast<double>(it->second));
+                it = spec_.config.find("pose_minimum_jump");
+                if (it != spec_.config.end())
+                    state_space_->setMinimumJump(boost::lexical_cast<double>(it->second));
+                it = spec_.config.find("analytic_kinematics");
+                if (it != spec_.config.end())
+                    state_space_->setAnalyticIK(it->second == "1" || it->second == "true");
+                if (spec_.reachability_map)
+                    state_space_->setReachabilityMap(spec_.reachability_map);
                 mbss_ = std::static_pointer_cast<ModelBasedStateSpace>(state_space_);
                 allocated = true;
             }
         }
     }
 
-    // The default is a representation based on the joint angles of the group
+    // The default is a representation based on the joint angles of the group.  Common group
+    // sizes use a specialization with fixed size loops.
     if (!allocated)
     {
-        JointModelStateSpacePtr state_space_(new JointModelStateSpace(state_space_spec));
+        JointModelStateSpacePtr state_space_(allocJointModelStateSpace(state_space_spec));
         mbss_ = std::static_pointer_cast<ModelBasedStateSpace>(state_space_);
     }
 }
@@ -278,6 +369,13 @@ ompl::base::StateSamplerPtr GeometricPlanningContext::allocPathConstrainedSample
 
     ROS_DEBUG("%s: Allocating a new state sampler (attempts to use path constraints)", name_.c_str());
 
+    // The state space bounds already enforce joint path constraints
+    if (joint_path_constraints_)
+    {
+        ROS_DEBUG("%s: Allocating default state sampler within the joint path constraints", name_.c_str());
+        return ss->allocDefaultStateSampler();
+    }
+
     //if (path_constraints_ && constraints_library_)
     if (path_constraints_)
     {
@@ -296,24 +394,45 @@ ompl::base::StateSamplerPtr GeometricPlanningContext::allocPathConstrainedSample
         //     }
         // }
 
-        constraint_samplers::ConstraintSamplerPtr cs = constraint_sampler_manager_->selectSampler(getPlanningScene(), getGroupName(), path_constraints_->getAllConstraints());
+        constraint_samplers::ConstraintSamplerPtr cs = selectPathConstraintSampler();
         if (cs)
         {
             ROS_INFO("%s: Allocating specialized state sampler for state space", name_.c_str());
-            return ompl::base::StateSamplerPtr(new ConstrainedSampler(this, cs));
+            return ompl::base::StateSamplerPtr(new ConstrainedSampler(this, cs, sample_producer_));
         }
     }
     ROS_DEBUG("%s: Allocating default state sampler for state space", name_.c_str());
     return ss->allocDefaultStateSampler();
 }
 
+constraint_samplers::ConstraintSamplerPtr GeometricPlanningContext::selectPathConstraintSampler() const
+{
+    if (!path_constraints_ || !constraint_sampler_manager_)
+        return constraint_samplers::ConstraintSamplerPtr();
+    return constraint_sampler_manager_->selectSampler(getPlanningScene(), getGroupName(), path_constraints_->getAllConstraints());
+}
+
 void GeometricPlanningContext::clear()
 {
     simple_setup_->clear();
     simple_setup_->clearStartStates();
     simple_setup_->setGoal(ompl::base::GoalPtr());
     simple_setup_->setStateValidityChecker(ompl::base::StateValidityCheckerPtr());
+    motion_validator_->clearCache();
     goal_constraints_.clear();
+
+    // The goal (and the goal states of its sampling workers) was destroyed with the problem definition;
+    // the buffer of the background sampler is allocated again by the next solve
+    if (sample_producer_)
+        sample_producer_->releaseStates();
+
+    // With the planner data and the problem definition cleared, the states of the space can be released in bulk.
+    // States may still be held elsewhere (e.g., by the samplers of the planner); return what is free then.
+    if (!mbss_->releaseStateMemory())
+    {
+        std::size_t trimmed = mbss_->trimStateMemory();
+        ROS_DEBUG("%s: States are still allocated; released %lu unused bytes of the state pool", getName().c_str(), trimmed);
+    }
 }
 
 void GeometricPlanningContext::preSolve()
@@ -322,15 +441,104 @@ void GeometricPlanningContext::preSolve()
     const ompl::base::PlannerPtr planner = simple_setup_->getPlanner();
     if(planner)
         planner->clear();
-    startGoalSampling();
+    motion_validator_->clearCache();
     simple_setup_->getSpaceInformation()->getMotionValidator()->resetMotionCounter();
+
+    // Discard anything gathered outside of solve (e.g., while setting up goals).  No thread may check
+    // states while the counters are merged and cleared, so this comes before goal sampling starts.
+    collectValidityStatistics();
+    validity_statistics_.clear();
+
+    // IK failures are only remembered within a solve
+    PoseModelStateSpacePtr pose_space = std::dynamic_pointer_cast<PoseModelStateSpace>(mbss_);
+    if (pose_space)
+        pose_space->clearIKFailures();
+
+    startGoalSampling();
+    if (sample_producer_)
+    {
+        sample_producer_->resetCounters();
+        sample_producer_->start();
+    }
 }
 
 void GeometricPlanningContext::postSolve()
 {
     stopGoalSampling();
+    storeGoalSamples();
+    if (sample_producer_)
+    {
+        sample_producer_->stop();
+        double run_time = sample_producer_->getRunTime();
+        ROS_DEBUG("%s: Background constrained sampling produced %lu samples (%.1f per second, %lu failed draws); "
+                  "%lu samples consumed, %lu times sampled inline", getName().c_str(), sample_producer_->getProducedCount(),
+                  run_time > 0.0 ? sample_producer_->getProducedCount() / run_time : 0.0, sample_producer_->getFailedDrawCount(),
+                  sample_producer_->getConsumedCount(), sample_producer_->getMissCount());
+    }
     if (simple_setup_->getProblemDefinition()->hasApproximateSolution())
         ROS_WARN("Solution is approximate");
+    ROS_DEBUG("%s: Motion validation performed %lu state checks; %lu segments (%lu state checks) answered from cache",
+              getName().c_str(), motion_validator_->getPerformedStateChecks(), motion_validator_->getCacheHits(),
+              motion_validator_->getSavedStateChecks());
+
+    PoseModelStateSpacePtr pose_space = std::dynamic_pointer_cast<PoseModelStateSpace>(mbss_);
+    if (pose_space)
+        ROS_DEBUG("%s: %lu IK calls answered from remembered failures", getName().c_str(), pose_space->getIKFailureHits());
+
+    collectValidityStatistics();
+    std::stringstream ss;
+    validity_statistics_.print(ss);
+    ROS_DEBUG("%s: State validity statistics (%f s total):\n%s", getName().c_str(),
+              validity_statistics_.getTotalTime(), ss.str().c_str());
+
+    const MemoryUsageReport &memory = getMemoryUsage();
+    std::stringstream ms;
+    printMemoryUsage(memory, ms);
+    ROS_DEBUG("%s: Memory usage (%lu bytes total):\n%s", getName().c_str(), getTotalBytes(memory), ms.str().c_str());
+}
+
+void GeometricPlanningContext::collectValidityStatistics()
+{
+    const StateValidityChecker *svc = dynamic_cast<const StateValidityChecker*>(simple_setup_->getStateValidityChecker().get());
+    if (svc)
+        svc->collectStatistics(validity_statistics_);
+}
+
+const StateValidityStatistics& GeometricPlanningContext::getStateValidityStatistics() const
+{
+    return validity_statistics_;
+}
+
+const MemoryUsageReport& GeometricPlanningContext::getMemoryUsage(bool include_planner)
+{
+    mbss_->getMemoryUsage(memory_usage_);
+    memory_usage_["motion_cache"].update(motion_validator_->getCacheMemoryUsage(), motion_validator_->getCacheSize());
+
+    const StateValidityChecker *svc = dynamic_cast<const StateValidityChecker*>(simple_setup_->getStateValidityChecker().get());
+    if (svc)
+        svc->getMemoryUsage(memory_usage_);
+
+    // The goal states themselves are allocated from the state space; only the references are counted here
+    std::size_t goal_states = 0;
+    const ompl::base::GoalPtr &goal = simple_setup_->getGoal();
+    if (goal && goal->hasType(ompl::base::GOAL_STATES))
+        goal_states = goal->as<ompl::base::GoalStates>()->getStateCount();
+    else if (goal && dynamic_cast<const GoalSampleableRegionMux*>(goal.get()))
+        goal_states = static_cast<const GoalSampleableRegionMux*>(goal.get())->getStateCount();
+    memory_usage_["goal_states"].update(goal_states * sizeof(ompl::base::State*), goal_states);
+
+    const ompl::base::PlannerPtr &planner = simple_setup_->getPlanner();
+    if (include_planner && planner)
+    {
+        // Tree and graph planners keep, per vertex, a motion with its state and parent pointers and an
+        // entry in their nearest neighbors structure.  The states are counted in "states".
+        ompl::base::PlannerData data(simple_setup_->getSpaceInformation());
+        planner->getPlannerData(data);
+        memory_usage_["planner"].update(data.numVertices() * 3 * sizeof(void*) + data.numEdges() * 2 * sizeof(void*),
+                                        data.numVertices());
+    }
+
+    return memory_usage_;
 }
 
 void GeometricPlanningContext::startGoalSampling()
@@ -343,6 +551,26 @@ void GeometricPlanningContext::startGoalSampling()
     static_cast<GoalSampleableRegionMux*>(simple_setup_->getGoal().get())->startSampling();
 }
 
+void GeometricPlanningContext::storeGoalSamples()
+{
+    if (!spec_.goal_sample_cache)
+        return;
+    const ompl::base::GoalPtr &goal = simple_setup_->getGoal();
+    ConstrainedGoalSampler *cgs = dynamic_cast<ConstrainedGoalSampler*>(goal.get());
+    if (cgs)
+        cgs->storeSamples();
+    else if (dynamic_cast<const GoalSampleableRegionMux*>(goal.get()))
+    {
+        const std::vector<ompl::base::GoalPtr> &goals = static_cast<const GoalSampleableRegionMux*>(goal.get())->getGoals();
+        for (std::size_t i = 0 ; i < goals.size() ; ++i)
+        {
+            cgs = dynamic_cast<ConstrainedGoalSampler*>(goals[i].get());
+            if (cgs)
+                cgs->storeSamples();
+        }
+    }
+}
+
 void GeometricPlanningContext::stopGoalSampling()
 {
   bool gls = simple_setup_->getGoal()->hasType(ompl::base::GOAL_LAZY_SAMPLES);
@@ -379,7 +607,7 @@ bool GeometricPlanningContext::solve(planning_interface::MotionPlanResponse& res
         if (interpolate_)
         {
             // The maximum length of a single segment in the solution path
-            double max_segment_length = (spec_.max_waypoint_distance > 0.0 ? spec_.max_waypoint_distance : simple_setup_->getStateSpace()->getMaximumExtent() / 100.0);
+            double max_segment_length = (spec_.max_waypoint_distance > 0.0 ? spec_.max_waypoint_distance : unrestricted_extent_ / 100.0);
             // Computing the total number of waypoints we want in the solution path
             unsigned int waypoint_count = std::max((unsigned int)floor(0.5 + pg.length() / max_segment_length), spec_.min_waypoint_count);
             interpolateSolution(pg, waypoint_count);
@@ -457,7 +685,7 @@ bool GeometricPlanningContext::solve(planning_interface::MotionPlanDetailedRespo
         {
             pg = simple_setup_->getSolutionPath();
             // The maximum length of a single segment in the solution path
-            double max_segment_length = (spec_.max_waypoint_distance > 0.0 ? spec_.max_waypoint_distance : simple_setup_->getStateSpace()->getMaximumExtent() / 100.0);
+            double max_segment_length = (spec_.max_waypoint_distance > 0.0 ? spec_.max_waypoint_distance : unrestricted_extent_ / 100.0);
             // Computing the total number of waypoints we want in the solution path
             unsigned int waypoint_count = std::max((unsigned int)floor(0.5 + pg.length() / max_segment_length), spec_.min_waypoint_count);
             double interpolate_time = interpolateSolution(pg, waypoint_count);
@@ -582,7 +810,13 @@ bool GeometricPlanningContext::solve(double timeout, unsigned int count, double&
 
 double GeometricPlanningContext::simplifySolution(double max_time)
 {
+    // The motion validator cache is kept from the preceding solve, so segments that were
+    // already checked during planning are not checked again
+    std::size_t saved = motion_validator_->getSavedStateChecks();
     simple_setup_->simplifySolution(max_time);
+    ROS_DEBUG("%s: Simplification avoided %lu state checks using the motion cache", getName().c_str(),
+              motion_validator_->getSavedStateChecks() - saved);
+    collectValidityStatistics();
     return simple_setup_->getLastSimplificationTime();
 }
 
@@ -649,8 +883,12 @@ void GeometricPlanningContext::setCompleteInitialRobotState(const robot_state::R
     mbss_->copyToOMPLState(start_state.get(), *complete_initial_robot_state_);
     simple_setup_->setStartState(start_state);
 
-    // State validity checker
-    simple_setup_->setStateValidityChecker(ompl::base::StateValidityCheckerPtr(new StateValidityChecker(this)));
+    // State validity checker.  Optimizing planners query cost and clearance of the states they
+    // validate, so compute all of them with a single collision query.
+    StateValidityChecker *svc = new StateValidityChecker(this);
+    const ompl::base::PlannerPtr &planner = simple_setup_->getPlanner();
+    svc->setCombinedEvaluation(planner && planner->getSpecs().optimizingPaths);
+    simple_setup_->setStateValidityChecker(ompl::base::StateValidityCheckerPtr(svc));
 }
 
 bool GeometricPlanningContext::setGoalConstraints(const std::vector<moveit_msgs::Constraints> &goal_constraints,
@@ -666,6 +904,7 @@ bool GeometricPlanningContext::setGoalConstraints(const std::vector<moveit_msgs:
 
     // Merge path constraints (if any) with goal constraints
     goal_constraints_.clear();
+    std::vector<GoalSampleCache::Key> goal_keys;
     for(size_t i = 0; i < goal_constraints.size(); ++i)
     {
         // NOTE: This only "intelligently" merges joint constraints.  All other constraint types are simply concatenated.
@@ -684,7 +923,10 @@ bool GeometricPlanningContext::setGoalConstraints(const std::vector<moveit_msgs:
         kinematic_constraints::KinematicConstraintSetPtr kset(new kinematic_constraints::KinematicConstraintSet(getRobotModel()));
         kset->add(constr, getPlanningScene()->getTransforms());
         if (!kset->empty())
+        {
             goal_constraints_.push_back(kset);
+            goal_keys.push_back(GoalSampleCache::computeKey(getGroupName(), constr));
+        }
     }
 
     if (goal_constraints_.empty())
@@ -704,7 +946,17 @@ bool GeometricPlanningContext::setGoalConstraints(const std::vector<moveit_msgs:
             cs = constraint_sampler_manager_->selectSampler(getPlanningScene(), getGroupName(), goal_constraints_[i]->getAllConstraints());
         if (cs)
         {
-            ompl::base::GoalPtr g = ompl::base::GoalPtr(new ConstrainedGoalSampler(this, goal_constraints_[i], cs));
+            // Additional goal sampling threads each need their own constraint sampler
+            std::vector<constraint_samplers::ConstraintSamplerPtr> helper_samplers;
+            for (unsigned int t = 1 ; t < getGoalSamplingThreads() ; ++t)
+            {
+                constraint_samplers::ConstraintSamplerPtr hcs = constraint_sampler_manager_->selectSampler(getPlanningScene(), getGroupName(),
+                                                                                                          goal_constraints_[i]->getAllConstraints());
+                if (hcs)
+                    helper_samplers.push_back(hcs);
+            }
+            ompl::base::GoalPtr g = ompl::base::GoalPtr(new ConstrainedGoalSampler(this, goal_constraints_[i], cs, helper_samplers,
+                                                                                    spec_.goal_sample_cache, goal_keys[i]));
             goals.push_back(g);
         }
         else
@@ -713,14 +965,23 @@ bool GeometricPlanningContext::setGoalConstraints(const std::vector<moveit_msgs:
         }
     }
 
-    // Creating goal object using constraint samplers
+    // Creating goal object using constraint samplers; goal sampling starts in preSolve()
     if (!goals.empty())
     {
         ompl::base::GoalPtr goal;
         if (goals.size() == 1)
             goal = goals[0];
         else
-            goal = ompl::base::GoalPtr(new GoalSampleableRegionMux(goals));
+        {
+            // With more goal regions than processors, a bounded pool of threads samples them
+            unsigned int processors = std::max(1u, boost::thread::hardware_concurrency());
+            unsigned int pool_threads = goals.size() > processors ? processors : 0;
+            // The goal states of the regions are indexed with the metric of the state space, if possible
+            JointSpaceMetric::Scope scope(joint_space_metric_.get());
+            goal = ompl::base::GoalPtr(new GoalSampleableRegionMux(goals, pool_threads));
+            if (pool_threads > 0)
+                ROS_DEBUG("%s: Sampling %u goal regions with %u threads", getName().c_str(), (unsigned int)goals.size(), pool_threads);
+        }
 
         simple_setup_->setGoal(goal);
         return true;
@@ -735,6 +996,16 @@ const kinematic_constraints::KinematicConstraintSetPtr& GeometricPlanningContext
     return path_constraints_;
 }
 
+JointPathConstraintTableConstPtr GeometricPlanningContext::getJointPathConstraints() const
+{
+    return joint_path_constraints_;
+}
+
+ReachabilityMapConstPtr GeometricPlanningContext::getReachabilityMap() const
+{
+    return spec_.reachability_map;
+}
+
 const robot_model::RobotModelConstPtr& GeometricPlanningContext::getRobotModel() const
 {
     return spec_.model;
@@ -750,7 +1021,12 @@ ompl::base::PlannerPtr GeometricPlanningContext::configurePlanner(const std::str
     std::map<std::string, PlannerAllocator>::const_iterator it = planner_allocators_.find(planner_name);
     // Allocating planner using planner allocator
     if (it != planner_allocators_.end())
-        return it->second(simple_setup_->getSpaceInformation(), spec_.name, params);
+    {
+        ompl::base::PlannerPtr planner = it->second(simple_setup_->getSpaceInformation(), spec_.name, params);
+        if (planner)
+            setNearestNeighbors(planner);
+        return planner;
+    }
 
     // No planner configured by this name
     ROS_WARN("No planner allocator found with name '%s'", planner_name.c_str());
@@ -759,6 +1035,28 @@ ompl::base::PlannerPtr GeometricPlanningContext::configurePlanner(const std::str
     return ompl::base::PlannerPtr();
 }
 
+void GeometricPlanningContext::setNearestNeighbors(const ompl::base::PlannerPtr &planner) const
+{
+    if (!joint_space_metric_)
+        return;
+
+    // The nearest neighbors structures constructed in this scope use the metric of the state space
+    JointSpaceMetric::Scope scope(joint_space_metric_.get());
+    if (og::RRTConnect *p = dynamic_cast<og::RRTConnect*>(planner.get()))
+        p->setNearestNeighbors<NearestNeighborsJointSpace>();
+    else if (og::RRTstar *p = dynamic_cast<og::RRTstar*>(planner.get()))
+        p->setNearestNeighbors<NearestNeighborsJointSpace>();
+    else if (og::TRRT *p = dynamic_cast<og::TRRT*>(planner.get()))
+        p->setNearestNeighbors<NearestNeighborsJointSpace>();
+    else if (og::LazyRRT *p = dynamic_cast<og::LazyRRT*>(planner.get()))
+        p->setNearestNeighbors<NearestNeighborsJointSpace>();
+    else if (og::RRT *p = dynamic_cast<og::RRT*>(planner.get()))
+        p->setNearestNeighbors<NearestNeighborsJointSpace>();
+    else
+        return;
+    ROS_DEBUG("%s: Using joint space nearest neighbors for planner '%s'", getName().c_str(), planner->getName().c_str());
+}
+
 void GeometricPlanningContext::setProjectionEvaluator(const std::string &peval)
 {
     if (!mbss_)
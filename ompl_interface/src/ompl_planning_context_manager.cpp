@@ -72,6 +72,16 @@ bool OMPLPlanningContextManager::initialize(const robot_model::RobotModelConstPt
 
     // read in planner configurations and group information from param server
     configurePlanningContexts();
+    loadReachabilityMaps();
+
+    // Reusing goal states across requests is opt-in: it keeps goal states in memory between requests
+    // and changes which goal states a planner sees first
+    bool goal_sample_cache;
+    nh_.param("goal_sample_cache", goal_sample_cache, false);
+    if (goal_sample_cache)
+        goal_sample_cache_.reset(new GoalSampleCache());
+    else
+        goal_sample_cache_.reset();
 
     return planning_interface::PlannerManager::initialize(model, ns);
 }
@@ -148,6 +158,10 @@ planning_interface::PlanningContextPtr OMPLPlanningContextManager::getPlanningCo
         spec.config = config.config;
         spec.model = kmodel_;
         spec.constraint_sampler_mgr = constraint_sampler_manager_;
+        std::map<std::string, ReachabilityMapConstPtr>::const_iterator rm = reachability_maps_.find(config.group);
+        if (rm != reachability_maps_.end())
+            spec.reachability_map = rm->second;
+        spec.goal_sample_cache = goal_sample_cache_;
 
         spec.simplify_solution = simplify_;
         spec.interpolate_solution = interpolate_;
@@ -279,13 +293,57 @@ void OMPLPlanningContextManager::configurePlanningContexts()
     setPlannerConfigurations(pconfig);
 }
 
+const MemoryUsageReport& OMPLPlanningContextManager::getMemoryUsage()
+{
+    if (goal_sample_cache_)
+        memory_usage_["goal_sample_cache"].update(goal_sample_cache_->getMemoryUsage(), goal_sample_cache_->getSampleCount());
+    else
+        memory_usage_["goal_sample_cache"].update(0, 0);
+
+    std::size_t bytes = 0, cells = 0;
+    for (std::map<std::string, ReachabilityMapConstPtr>::const_iterator it = reachability_maps_.begin() ; it != reachability_maps_.end() ; ++it)
+    {
+        bytes += it->second->getMemoryUsage();
+        cells += it->second->getCellCount();
+    }
+    memory_usage_["reachability_maps"].update(bytes, cells);
+    return memory_usage_;
+}
+
+void OMPLPlanningContextManager::loadReachabilityMaps()
+{
+    reachability_maps_.clear();
+    const std::vector<std::string> &group_names = kmodel_->getJointModelGroupNames();
+    for (std::size_t i = 0 ; i < group_names.size() ; ++i)
+    {
+        std::string filename;
+        if (!nh_.getParam(group_names[i] + "/reachability_map", filename) || filename.empty())
+            continue;
+
+        ReachabilityMapPtr map(new ReachabilityMap());
+        if (!map->load(filename))
+            continue;
+        if (map->getGroupName() != group_names[i])
+        {
+            ROS_ERROR("Reachability map '%s' was built for group '%s', not '%s'", filename.c_str(),
+                      map->getGroupName().c_str(), group_names[i].c_str());
+            continue;
+        }
+        ROS_INFO("Loaded reachability map for group '%s' from '%s' (%lu bytes)", group_names[i].c_str(), filename.c_str(),
+                 map->getMemoryUsage());
+        reachability_maps_[group_names[i]] = map;
+    }
+}
+
 void OMPLPlanningContextManager::getGroupSpecificParameters(const std::string& group_name,
                                                     std::map<std::string, std::string>& specific_group_params)
 {
     // the set of planning parameters that can be specific for the group (inherited by configurations of that group)
     static const std::string KNOWN_GROUP_PARAMS[] =
     {
-        "projection_evaluator", "longest_valid_segment_fraction"
+        "projection_evaluator", "longest_valid_segment_fraction", "pose_jump_factor", "pose_minimum_jump",
+        "analytic_kinematics", "constrained_sampling_threads", "max_goal_samples", "max_goal_sampling_attempts",
+        "max_state_sampling_attempts", "goal_sampling_threads"
     };
 
     for (std::size_t k = 0 ; k < sizeof(KNOWN_GROUP_PARAMS) / sizeof(std::string) ; ++k)
@@ -0,0 +1,61 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2015, Rice University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Rice University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+#include "moveit/ompl_interface/parameterization/joint_space/fixed_joint_model_state_space.h"
+
+namespace ompl_interface
+{
+// the common sizes: single arms with 6 or 7 joints, and pairs of them
+template class FixedJointModelStateSpace<6>;
+template class FixedJointModelStateSpace<7>;
+template class FixedJointModelStateSpace<12>;
+template class FixedJointModelStateSpace<14>;
+}
+
+ompl_interface::JointModelStateSpace* ompl_interface::allocJointModelStateSpace(const ModelBasedStateSpaceSpecification &spec)
+{
+  switch (spec.joint_model_group_->getVariableCount())
+  {
+  case 6:
+    return new FixedJointModelStateSpace<6>(spec);
+  case 7:
+    return new FixedJointModelStateSpace<7>(spec);
+  case 12:
+    return new FixedJointModelStateSpace<12>(spec);
+  case 14:
+    return new FixedJointModelStateSpace<14>(spec);
+  default:
+    return new JointModelStateSpace(spec);
+  }
+}
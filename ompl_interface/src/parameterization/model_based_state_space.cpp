@@ -35,16 +35,23 @@
 /* Author: Ioan Sucan */
 
 #include "moveit/ompl_interface/parameterization/model_based_state_space.h"
+#include "moveit/ompl_interface/detail/joint_space_kernels.h"
 #include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cstring>
+#include <new>
 
 ompl_interface::ModelBasedStateSpace::ModelBasedStateSpace(const ModelBasedStateSpaceSpecification &spec)
   : ompl::base::StateSpace()
   , spec_(spec)
+  , state_pool_(sizeof(StateType))
 {
   // set the state space name
   setName(spec_.joint_model_group_->getName());
   variable_count_ = spec_.joint_model_group_->getVariableCount();
   state_values_size_ = variable_count_ * sizeof(double);
+  setStateLayout(sizeof(StateType));
   joint_model_vector_ = spec_.joint_model_group_->getActiveJointModels();
 
   // make sure we have bounds for every joint stored within the spec (use default bounds if not specified)
@@ -67,6 +74,31 @@ ompl_interface::ModelBasedStateSpace::ModelBasedStateSpace(const ModelBasedState
     spec_.joint_bounds_[i] = &joint_bounds_storage_[i];
   }
 
+  // groups made only of bounded single-variable joints (e.g., most arms) do not need to go through
+  // the joint models for distance, interpolation and bounds
+  simple_joints_ = !joint_model_vector_.empty() && variable_count_ == joint_model_vector_.size();
+  for (std::size_t i = 0 ; simple_joints_ && i < joint_model_vector_.size() ; ++i)
+  {
+    const robot_model::JointModel *jm = joint_model_vector_[i];
+    if (jm->getType() == robot_model::JointModel::REVOLUTE)
+      simple_joints_ = !static_cast<const robot_model::RevoluteJointModel*>(jm)->isContinuous();
+    else
+      simple_joints_ = jm->getType() == robot_model::JointModel::PRISMATIC;
+    simple_joints_ = simple_joints_ && spec_.joint_model_group_->getVariableGroupIndex(jm->getName()) == (int)i;
+  }
+  if (simple_joints_)
+  {
+    // same margin as satisfiesBounds() uses for the generic path
+    const double margin = std::numeric_limits<double>::epsilon();
+    for (std::size_t i = 0 ; i < joint_model_vector_.size() ; ++i)
+    {
+      const robot_model::VariableBounds &b = (*spec_.joint_bounds_[i])[0];
+      simple_joint_weights_.push_back(joint_model_vector_[i]->getDistanceFactor());
+      simple_joint_lower_.push_back(b.min_position_ - margin);
+      simple_joint_upper_.push_back(b.max_position_ + margin);
+    }
+  }
+
   // default settings
   setTagSnapToSegment(0.95);
 
@@ -96,17 +128,58 @@ void ompl_interface::ModelBasedStateSpace::setTagSnapToSegment(double snap)
   }
 }
 
+void ompl_interface::ModelBasedStateSpace::setStateLayout(std::size_t header_size, std::size_t extra_values)
+{
+  state_values_offset_ = (header_size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+  if (!state_pool_.setBlockSize(state_values_offset_ + state_values_size_ + extra_values * sizeof(double)))
+    ROS_ERROR("Cannot change the layout of states of '%s' while states are allocated", getName().c_str());
+}
+
+bool ompl_interface::ModelBasedStateSpace::releaseStateMemory()
+{
+  return state_pool_.release();
+}
+
+std::size_t ompl_interface::ModelBasedStateSpace::trimStateMemory()
+{
+  return state_pool_.trim();
+}
+
+void ompl_interface::ModelBasedStateSpace::getMemoryUsage(MemoryUsageReport &report) const
+{
+  const std::size_t block_size = state_pool_.getBlockSize();
+
+  MemoryUsage &states = report["states"];
+  states.update(state_pool_.getBlocksInUse() * block_size, state_pool_.getBlocksInUse());
+  const std::size_t peak = state_pool_.getPeakBlocksInUse();
+  if (peak > states.peak_objects)
+  {
+    states.peak_objects = peak;
+    states.peak_bytes = peak * block_size;
+  }
+
+  const std::size_t reserved = state_pool_.getReservedMemory();
+  report["state_pool"].update(reserved, reserved / block_size);
+}
+
+void ompl_interface::ModelBasedStateSpace::resetStateMemoryPeak()
+{
+  state_pool_.resetPeakBlocksInUse();
+}
+
 ompl::base::State* ompl_interface::ModelBasedStateSpace::allocState() const
 {
-  StateType *state = new StateType();
-  state->values = new double[variable_count_];
+  void *block = allocStateBlock();
+  StateType *state = new (block) StateType();
+  state->values = getStateBlockValues(block);
   return state;
 }
 
 void ompl_interface::ModelBasedStateSpace::freeState(ompl::base::State *state) const
 {
-  delete[] state->as<StateType>()->values;
-  delete state->as<StateType>();
+  // StateType (and the StateType of derived spaces) is at the start of the block
+  state->as<StateType>()->~StateType();
+  state_pool_.free(state);
 }
 
 void ompl_interface::ModelBasedStateSpace::copyState(ompl::base::State *destination, const ompl::base::State *source) const
@@ -115,6 +188,7 @@ void ompl_interface::ModelBasedStateSpace::copyState(ompl::base::State *destinat
   destination->as<StateType>()->tag = source->as<StateType>()->tag;
   destination->as<StateType>()->flags = source->as<StateType>()->flags;
   destination->as<StateType>()->distance = source->as<StateType>()->distance;
+  destination->as<StateType>()->cost = source->as<StateType>()->cost;
 }
 
 unsigned int ompl_interface::ModelBasedStateSpace::getSerializationLength() const
@@ -134,6 +208,164 @@ void ompl_interface::ModelBasedStateSpace::deserialize(ompl::base::State *state,
   memcpy(state->as<StateType>()->values, reinterpret_cast<const char*>(serialization) + sizeof(int), state_values_size_);
 }
 
+namespace
+{
+const char STATE_FILE_MAGIC[4] = { 'M', 'B', 'S', 'S' };
+const boost::uint32_t STATE_FILE_VERSION = 1;
+// written in native byte order; read back as a different value on a machine with another byte order
+const boost::uint32_t STATE_FILE_BYTE_ORDER = 0x01020304;
+// states are read and written in blocks of this many
+const std::size_t STATE_FILE_BLOCK = 4096;
+
+void writeUInt(std::ostream &out, boost::uint32_t value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool readUInt(std::istream &in, boost::uint32_t &value)
+{
+  return in.read(reinterpret_cast<char*>(&value), sizeof(value)).good();
+}
+
+void writeString(std::ostream &out, const std::string &str)
+{
+  writeUInt(out, str.size());
+  out.write(str.data(), str.size());
+}
+
+bool readString(std::istream &in, std::string &str)
+{
+  boost::uint32_t length;
+  if (!readUInt(in, length) || length > (1 << 16))
+    return false;
+  str.resize(length);
+  return length == 0 || in.read(&str[0], length).good();
+}
+}
+
+bool ompl_interface::ModelBasedStateSpace::storeStates(std::ostream &out, const ompl::base::State * const *states, std::size_t count) const
+{
+  // header
+  out.write(STATE_FILE_MAGIC, sizeof(STATE_FILE_MAGIC));
+  writeUInt(out, STATE_FILE_VERSION);
+  writeUInt(out, STATE_FILE_BYTE_ORDER);
+  writeString(out, getName());
+  writeString(out, getJointModelGroupName());
+  const std::vector<std::string> &variables = spec_.joint_model_group_->getVariableNames();
+  writeUInt(out, variables.size());
+  for (std::size_t i = 0 ; i < variables.size() ; ++i)
+    writeString(out, variables[i]);
+  std::vector<int> signature;
+  computeSignature(signature);
+  writeUInt(out, signature.size());
+  for (std::size_t i = 0 ; i < signature.size() ; ++i)
+    writeUInt(out, signature[i]);
+  boost::uint64_t n = count;
+  out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+
+  // records of the tag followed by the values, gathered in blocks
+  const std::size_t record_size = sizeof(boost::int32_t) + state_values_size_;
+  std::vector<char> buffer(record_size * std::min(count, STATE_FILE_BLOCK));
+  for (std::size_t start = 0 ; start < count && out.good() ; start += STATE_FILE_BLOCK)
+  {
+    std::size_t end = std::min(count, start + STATE_FILE_BLOCK);
+    char *record = buffer.empty() ? NULL : &buffer[0];
+    for (std::size_t i = start ; i < end ; ++i, record += record_size)
+    {
+      boost::int32_t tag = states[i]->as<StateType>()->tag;
+      memcpy(record, &tag, sizeof(tag));
+      memcpy(record + sizeof(tag), states[i]->as<StateType>()->values, state_values_size_);
+    }
+    out.write(&buffer[0], (end - start) * record_size);
+  }
+  return out.good();
+}
+
+bool ompl_interface::ModelBasedStateSpace::loadStates(std::istream &in, std::vector<ompl::base::State*> &states) const
+{
+  char magic[sizeof(STATE_FILE_MAGIC)];
+  boost::uint32_t version, byte_order;
+  if (!in.read(magic, sizeof(magic)).good() || memcmp(magic, STATE_FILE_MAGIC, sizeof(magic)) != 0 ||
+      !readUInt(in, version) || !readUInt(in, byte_order))
+  {
+    ROS_ERROR("Stream does not contain states of a model based state space");
+    return false;
+  }
+  if (version != STATE_FILE_VERSION || byte_order != STATE_FILE_BYTE_ORDER)
+  {
+    ROS_ERROR("Unsupported state file version (%u) or byte order", version);
+    return false;
+  }
+
+  std::string space_name, group_name;
+  boost::uint32_t variable_count;
+  if (!readString(in, space_name) || !readString(in, group_name) || !readUInt(in, variable_count))
+    return false;
+  const std::vector<std::string> &variables = spec_.joint_model_group_->getVariableNames();
+  if (group_name != getJointModelGroupName() || variable_count != variables.size())
+  {
+    ROS_ERROR("States were stored for group '%s', but this space is for group '%s'", group_name.c_str(), getJointModelGroupName().c_str());
+    return false;
+  }
+  for (std::size_t i = 0 ; i < variables.size() ; ++i)
+  {
+    std::string name;
+    if (!readString(in, name))
+      return false;
+    if (name != variables[i])
+    {
+      ROS_ERROR("Stored states have variable '%s' where '%s' is expected", name.c_str(), variables[i].c_str());
+      return false;
+    }
+  }
+
+  boost::uint32_t signature_size;
+  if (!readUInt(in, signature_size))
+    return false;
+  std::vector<int> signature, stored_signature(signature_size);
+  computeSignature(signature);
+  for (std::size_t i = 0 ; i < signature_size ; ++i)
+  {
+    boost::uint32_t v;
+    if (!readUInt(in, v))
+      return false;
+    stored_signature[i] = v;
+  }
+  if (signature != stored_signature)
+  {
+    ROS_ERROR("States were stored for space '%s', which does not match space '%s'", space_name.c_str(), getName().c_str());
+    return false;
+  }
+
+  boost::uint64_t count;
+  if (!in.read(reinterpret_cast<char*>(&count), sizeof(count)).good())
+    return false;
+
+  const std::size_t record_size = sizeof(boost::int32_t) + state_values_size_;
+  std::vector<char> buffer(record_size * std::min<boost::uint64_t>(count, STATE_FILE_BLOCK));
+  states.reserve(states.size() + std::min<boost::uint64_t>(count, 1 << 20));
+  for (boost::uint64_t start = 0 ; start < count ; start += STATE_FILE_BLOCK)
+  {
+    std::size_t n = std::min<boost::uint64_t>(count - start, STATE_FILE_BLOCK);
+    if (!in.read(&buffer[0], n * record_size).good())
+    {
+      ROS_ERROR("State data is truncated: read %lu of %lu states", (unsigned long)start, (unsigned long)count);
+      return false;
+    }
+    const char *record = &buffer[0];
+    for (std::size_t i = 0 ; i < n ; ++i, record += record_size)
+    {
+      ompl::base::State *state = allocState();
+      boost::int32_t tag;
+      memcpy(&tag, record, sizeof(tag));
+      state->as<StateType>()->tag = tag;
+      memcpy(state->as<StateType>()->values, record + sizeof(tag), state_values_size_);
+      states.push_back(state);
+    }
+  }
+  return true;
+}
+
 unsigned int ompl_interface::ModelBasedStateSpace::getDimension() const
 {
   unsigned int d = 0;
@@ -165,16 +397,15 @@ double ompl_interface::ModelBasedStateSpace::distance(const ompl::base::State *s
 {
   if (distance_function_)
     return distance_function_(state1, state2);
+  else if (simple_joints_)
+    return kernels::weightedDistance(state1->as<StateType>()->values, state2->as<StateType>()->values, &simple_joint_weights_[0], variable_count_);
   else
     return spec_.joint_model_group_->distance(state1->as<StateType>()->values, state2->as<StateType>()->values);
 }
 
 bool ompl_interface::ModelBasedStateSpace::equalStates(const ompl::base::State *state1, const ompl::base::State *state2) const
 {
-  for (unsigned int i = 0 ; i < variable_count_ ; ++i)
-    if (fabs(state1->as<StateType>()->values[i] - state2->as<StateType>()->values[i]) > std::numeric_limits<double>::epsilon())
-      return false;
-  return true;
+  return kernels::equal(state1->as<StateType>()->values, state2->as<StateType>()->values, std::numeric_limits<double>::epsilon(), variable_count_);
 }
 
 void ompl_interface::ModelBasedStateSpace::enforceBounds(ompl::base::State *state) const
@@ -184,6 +415,8 @@ void ompl_interface::ModelBasedStateSpace::enforceBounds(ompl::base::State *stat
 
 bool ompl_interface::ModelBasedStateSpace::satisfiesBounds(const ompl::base::State *state) const
 {
+  if (simple_joints_)
+    return kernels::withinBounds(state->as<StateType>()->values, &simple_joint_lower_[0], &simple_joint_upper_[0], variable_count_);
   return spec_.joint_model_group_->satisfiesPositionBounds(state->as<StateType>()->values, spec_.joint_bounds_, std::numeric_limits<double>::epsilon());
 }
 
@@ -195,19 +428,34 @@ void ompl_interface::ModelBasedStateSpace::interpolate(const ompl::base::State *
   if (!interpolation_function_ || !interpolation_function_(from, to, t, state))
   {
     // perform the actual interpolation
-    spec_.joint_model_group_->interpolate(from->as<StateType>()->values, to->as<StateType>()->values, t, state->as<StateType>()->values);
+    if (simple_joints_)
+      kernels::interpolate(from->as<StateType>()->values, to->as<StateType>()->values, t, state->as<StateType>()->values, variable_count_);
+    else
+      spec_.joint_model_group_->interpolate(from->as<StateType>()->values, to->as<StateType>()->values, t, state->as<StateType>()->values);
 
     // compute tag
-    if (from->as<StateType>()->tag >= 0 && t < 1.0 - tag_snap_to_segment_)
-      state->as<StateType>()->tag = from->as<StateType>()->tag;
-    else
-      if (to->as<StateType>()->tag >= 0 && t > tag_snap_to_segment_)
-        state->as<StateType>()->tag = to->as<StateType>()->tag;
-    else
-      state->as<StateType>()->tag = -1;
+    interpolateTag(from, to, t, state);
   }
 }
 
+void ompl_interface::ModelBasedStateSpace::interpolateSegment(const ompl::base::State *from, const ompl::base::State *to,
+                                                             unsigned int count, ompl::base::State **states) const
+{
+  for (unsigned int j = 1 ; j < count ; ++j)
+    interpolate(from, to, (double)j / (double)count, states[j - 1]);
+}
+
+void ompl_interface::ModelBasedStateSpace::interpolateTag(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const
+{
+  if (from->as<StateType>()->tag >= 0 && t < 1.0 - tag_snap_to_segment_)
+    state->as<StateType>()->tag = from->as<StateType>()->tag;
+  else
+    if (to->as<StateType>()->tag >= 0 && t > tag_snap_to_segment_)
+      state->as<StateType>()->tag = to->as<StateType>()->tag;
+  else
+    state->as<StateType>()->tag = -1;
+}
+
 double* ompl_interface::ModelBasedStateSpace::getValueAddressAtIndex(ompl::base::State *state, const unsigned int index) const
 {
   if (index >= variable_count_)
@@ -37,12 +37,66 @@
 #include "moveit/ompl_interface/parameterization/work_space/pose_model_state_space.h"
 #include <ompl/base/spaces/SE3StateSpace.h>
 #include <moveit/profiler/profiler.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace
+{
+// Buffers for the joint values passed to the kinematics solvers, reused by every call of a thread
+struct KinematicsScratch
+{
+  std::vector<double> seed;
+  std::vector<double> solution;
+  std::vector<long long> failure_key;
+};
+thread_local KinematicsScratch kinematics_scratch;
+
+std::string stripLeadingSlash(const std::string &frame)
+{
+  return !frame.empty() && frame[0] == '/' ? frame.substr(1) : frame;
+}
+
+// Resolution of the poses remembered as IK failures: 1 mm, and about 0.1 degree for the orientation
+const double IK_FAILURE_POSITION_RESOLUTION = 1e-3;
+const double IK_FAILURE_ORIENTATION_RESOLUTION = 1e-3;
+// Resolution of the seeds remembered with the failures of numerical solvers, in radians (or meters)
+const double IK_FAILURE_SEED_RESOLUTION = 1e-2;
+// Beyond this many remembered failures, the memo is cleared
+const std::size_t IK_FAILURE_MAX_COUNT = 100000;
+
+// Samples drawn at most for one uniform sample, when sampling is biased by a reachability map
+const unsigned int REACHABILITY_SAMPLING_ATTEMPTS = 4;
+
+// The key of a pose in the IK failure memo: its quantized position and orientation, followed by the
+// quantized seed for solvers that are not analytic, whose failures depend on the seed as well
+void makeIKFailureKey(const geometry_msgs::Pose &pose, const std::vector<double> *seed, std::vector<long long> &key)
+{
+  // q and -q are the same orientation
+  double sign = pose.orientation.w < 0.0 ? -1.0 : 1.0;
+  key.clear();
+  key.push_back(std::llround(pose.position.x / IK_FAILURE_POSITION_RESOLUTION));
+  key.push_back(std::llround(pose.position.y / IK_FAILURE_POSITION_RESOLUTION));
+  key.push_back(std::llround(pose.position.z / IK_FAILURE_POSITION_RESOLUTION));
+  key.push_back(std::llround(sign * pose.orientation.x / IK_FAILURE_ORIENTATION_RESOLUTION));
+  key.push_back(std::llround(sign * pose.orientation.y / IK_FAILURE_ORIENTATION_RESOLUTION));
+  key.push_back(std::llround(sign * pose.orientation.z / IK_FAILURE_ORIENTATION_RESOLUTION));
+  key.push_back(std::llround(sign * pose.orientation.w / IK_FAILURE_ORIENTATION_RESOLUTION));
+  if (seed)
+    for (std::size_t i = 0 ; i < seed->size() ; ++i)
+      key.push_back(std::llround((*seed)[i] / IK_FAILURE_SEED_RESOLUTION));
+}
+}
 
 const std::string ompl_interface::PoseModelStateSpace::PARAMETERIZATION_TYPE = "PoseModel";
 
 ompl_interface::PoseModelStateSpace::PoseModelStateSpace(const ModelBasedStateSpaceSpecification &spec) : ModelBasedStateSpace(spec)
 {
-  jump_factor_ = 3; // \todo make this a param
+  jump_factor_ = 3;
+  minimum_jump_ = 0.2;
 
   if (spec.joint_model_group_->getGroupKinematics().first)
     poses_.push_back(PoseComponent(spec.joint_model_group_, spec.joint_model_group_->getGroupKinematics().first));
@@ -56,8 +110,27 @@ ompl_interface::PoseModelStateSpace::PoseModelStateSpace(const ModelBasedStateSp
   if (poses_.empty())
     ROS_ERROR("No kinematics solvers specified. Unable to construct a PoseModelStateSpace");
   else
+  {
     std::sort(poses_.begin(), poses_.end());
+    robot_state::RobotState default_state(spec.robot_model_);
+    default_state.setToDefaultValues();
+    std::shared_ptr<TSStateStorage> fk_states(new TSStateStorage(default_state));
+    for (std::size_t i = 0 ; i < poses_.size() ; ++i)
+      poses_[i].initializeFK(spec.joint_model_group_, fk_states);
+
+    // with several components (e.g., two arms), their IK calls run concurrently; the calling thread takes one
+    if (poses_.size() > 1)
+    {
+      unsigned int threads = std::min<unsigned int>(poses_.size() - 1, std::max(1u, boost::thread::hardware_concurrency() - 1));
+      components_pool_.reset(new WorkerPool(threads));
+    }
+  }
   setName(getName() + "_" + PARAMETERIZATION_TYPE);
+
+  // each state is a single block: the StateType, the array of pose pointers and the SE3 states,
+  // followed by the joint values and then the positions of all poses
+  setStateLayout(sizeof(StateType) + poses_.size() * (sizeof(ompl::base::SE3StateSpace::StateType*) + sizeof(PoseStorage)),
+                 poses_.size() * 3);
 }
 
 ompl_interface::PoseModelStateSpace::~PoseModelStateSpace()
@@ -66,6 +139,8 @@ ompl_interface::PoseModelStateSpace::~PoseModelStateSpace()
 
 double ompl_interface::PoseModelStateSpace::distance(const ompl::base::State *state1, const ompl::base::State *state2) const
 {
+  if (!ensurePoseComputed(state1) || !ensurePoseComputed(state2))
+    return std::numeric_limits<double>::infinity();
   double total = 0;
   for (std::size_t i = 0 ; i < poses_.size() ; ++i)
     total += poses_[i].state_space_->distance(state1->as<StateType>()->poses[i], state2->as<StateType>()->poses[i]);
@@ -82,19 +157,31 @@ double ompl_interface::PoseModelStateSpace::getMaximumExtent() const
 
 ompl::base::State* ompl_interface::PoseModelStateSpace::allocState() const
 {
-  StateType *state = new StateType();
-  state->values = new double[variable_count_]; // need to allocate this here since ModelBasedStateSpace::allocState() is not called
-  state->poses = new ompl::base::SE3StateSpace::StateType*[poses_.size()];
+  void *block = allocStateBlock();
+  StateType *state = new (block) StateType();
+  state->values = getStateBlockValues(block); // need to set this here since ModelBasedStateSpace::allocState() is not called
+  state->poses = reinterpret_cast<ompl::base::SE3StateSpace::StateType**>(state + 1);
+
+  // the SE3 states are wired to their components within the block, instead of being allocated by the SE3 spaces
+  PoseStorage *storage = reinterpret_cast<PoseStorage*>(state->poses + poses_.size());
+  double *positions = state->values + variable_count_;
   for (std::size_t i = 0 ; i < poses_.size() ; ++i)
-    state->poses[i] = poses_[i].state_space_->allocState()->as<ompl::base::SE3StateSpace::StateType>();
+  {
+    PoseStorage *p = new (storage + i) PoseStorage();
+    p->components[0] = &p->position;
+    p->components[1] = &p->rotation;
+    p->pose.components = p->components;
+    p->position.values = positions + 3 * i;
+    state->poses[i] = &p->pose;
+  }
   return state;
 }
 
 void ompl_interface::PoseModelStateSpace::freeState(ompl::base::State *state) const
 {
+  PoseStorage *storage = reinterpret_cast<PoseStorage*>(state->as<StateType>()->poses + poses_.size());
   for (std::size_t i = 0 ; i < poses_.size() ; ++i)
-    poses_[i].state_space_->freeState(state->as<StateType>()->poses[i]);
-  delete[] state->as<StateType>()->poses;
+    storage[i].~PoseStorage();
   ModelBasedStateSpace::freeState(state);
 }
 
@@ -103,11 +190,31 @@ void ompl_interface::PoseModelStateSpace::copyState(ompl::base::State *destinati
   // copy the state data
   ModelBasedStateSpace::copyState(destination, source);
 
+  // Copies are what planners store and share between threads, so a copy always has its poses: they
+  // are copied if they are known, and computed for the copy otherwise.  Only the thread that owns a
+  // state ever computes its poses.
+  StateType *dest = destination->as<StateType>();
+  const StateType *src = source->as<StateType>();
+  if (!src->poseComputed())
+  {
+    computeStateK(destination);
+    return;
+  }
+
+  // the positions of all poses are contiguous, after the joint values
+  memcpy(dest->values + variable_count_, src->values + variable_count_, poses_.size() * 3 * sizeof(double));
   for (std::size_t i = 0 ; i < poses_.size() ; ++i)
-    poses_[i].state_space_->copyState(destination->as<StateType>()->poses[i], source->as<StateType>()->poses[i]);
+  {
+    ompl::base::SO3StateSpace::StateType &r = dest->poses[i]->rotation();
+    const ompl::base::SO3StateSpace::StateType &q = src->poses[i]->rotation();
+    r.x = q.x;
+    r.y = q.y;
+    r.z = q.z;
+    r.w = q.w;
+  }
 
-  // compute additional stuff if needed
-  computeStateK(destination);
+  // the joints may not be known if the source was interpolated in workspace
+  computeStateIK(destination);
 }
 
 void ompl_interface::PoseModelStateSpace::sanityChecks() const
@@ -115,30 +222,44 @@ void ompl_interface::PoseModelStateSpace::sanityChecks() const
   ModelBasedStateSpace::sanityChecks(std::numeric_limits<double>::epsilon(), std::numeric_limits<float>::epsilon(), ~ompl::base::StateSpace::STATESPACE_TRIANGLE_INEQUALITY);
 }
 
-void ompl_interface::PoseModelStateSpace::interpolate(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const
+bool ompl_interface::PoseModelStateSpace::interpolatePoses(const ompl::base::State *from, const ompl::base::State *to, const double t,
+                                                           ompl::base::State *state) const
 {
-  //  moveit::Profiler::ScopedBlock sblock("interpolate");
-
-  // we want to interpolate in Cartesian space; we do not have a guarantee that from and to
-  // have their poses computed, but this is very unlikely to happen (depends how the planner gets its input states)
+  // we want to interpolate in Cartesian space; poses of from and to are computed if they are not known yet
 
   // interpolate in joint space
   ModelBasedStateSpace::interpolate(from, to, t, state);
+  if (!ensurePoseComputed(from) || !ensurePoseComputed(to))
+  {
+    state->as<StateType>()->setPoseComputed(false);
+    state->as<StateType>()->markInvalid();
+    return false;
+  }
 
-  // interpolate SE3 components
+  // interpolate the positions of all SE3 components at once; they are contiguous, after the joint values
+  const double *p_from = from->as<StateType>()->values + variable_count_;
+  const double *p_to = to->as<StateType>()->values + variable_count_;
+  double *p_state = state->as<StateType>()->values + variable_count_;
+  for (std::size_t i = 0 ; i < poses_.size() * 3 ; ++i)
+    p_state[i] = p_from[i] + (p_to[i] - p_from[i]) * t;
+
+  // interpolate the orientations
   for (std::size_t i = 0 ; i < poses_.size() ; ++i)
-    poses_[i].state_space_->interpolate(from->as<StateType>()->poses[i], to->as<StateType>()->poses[i], t, state->as<StateType>()->poses[i]);
+    poses_[i].state_space_->as<ompl::base::SE3StateSpace>()->getSubspace(1)->interpolate(&from->as<StateType>()->poses[i]->rotation(),
+                                                                                       &to->as<StateType>()->poses[i]->rotation(), t,
+                                                                                       &state->as<StateType>()->poses[i]->rotation());
 
-  // the call above may reset all flags for state; but we know the pose we want flag should be set
+  // the joint interpolation reset all flags for state; but we know the pose we want flag should be set
   state->as<StateType>()->setPoseComputed(true);
+  return true;
+}
 
-  /*
-  std::cout << "*********** interpolate\n";
-  printState(from, std::cout);
-  printState(to, std::cout);
-  printState(state, std::cout);
-  std::cout << "\n\n";
-  */
+void ompl_interface::PoseModelStateSpace::interpolate(const ompl::base::State *from, const ompl::base::State *to, const double t, ompl::base::State *state) const
+{
+  //  moveit::Profiler::ScopedBlock sblock("interpolate");
+
+  if (!interpolatePoses(from, to, t, state))
+    return;
 
   // after interpolation we cannot be sure about the joint values (we use them as seed only)
   // so we recompute IK if needed
@@ -149,9 +270,55 @@ void ompl_interface::PoseModelStateSpace::interpolate(const ompl::base::State *f
     double d_to = ModelBasedStateSpace::distance(state, to);
 
     // if the joint value jumped too much
-    if (d_from + d_to > std::max(0.2, dj)) // \todo make 0.2 a param
+    if (d_from + d_to > std::max(minimum_jump_, dj))
+      state->as<StateType>()->markInvalid();
+  }
+}
+
+void ompl_interface::PoseModelStateSpace::interpolateSegment(const ompl::base::State *from, const ompl::base::State *to,
+                                                            unsigned int count, ompl::base::State **states) const
+{
+  if (count < 2)
+    return;
+
+  // consecutive states are count times closer than the endpoints
+  const double max_step = std::max(minimum_jump_, jump_factor_ * ModelBasedStateSpace::distance(from, to) / (double)count);
+
+  // IK of every state is seeded with the joint values of the previous state along the motion, so the
+  // solver starts close to the solution and stays on the same branch
+  const ompl::base::State *previous = from;
+  unsigned int j = 1;
+  for ( ; j < count ; ++j)
+  {
+    ompl::base::State *state = states[j - 1];
+    if (!interpolatePoses(from, to, (double)j / (double)count, state))
+      break;
+    memcpy(state->as<StateType>()->values, previous->as<StateType>()->values, variable_count_ * sizeof(double));
+    if (!computeStateIK(state))
+      break;
+    if (ModelBasedStateSpace::distance(previous, state) > max_step)
+    {
       state->as<StateType>()->markInvalid();
+      break;
+    }
+    previous = state;
   }
+
+  // the motion is invalid at the first state that fails; the states after it are not computed, since
+  // they would be seeded from a state off the path, and are marked invalid so they are never checked
+  if (j < count)
+  {
+    for (++j ; j < count ; ++j)
+    {
+      states[j - 1]->as<StateType>()->clearKnownInformation();
+      states[j - 1]->as<StateType>()->markInvalid();
+    }
+    return;
+  }
+
+  // the solutions must also join the joint values of the endpoint
+  if (previous != from && ModelBasedStateSpace::distance(previous, to) > max_step)
+    states[count - 2]->as<StateType>()->markInvalid();
 }
 
 void ompl_interface::PoseModelStateSpace::setPlanningVolume(double minX, double maxX, double minY, double maxY, double minZ, double maxZ)
@@ -169,18 +336,68 @@ ompl_interface::PoseModelStateSpace::PoseComponent::PoseComponent(const robot_mo
   : subgroup_(subgroup)
   , kinematics_solver_(k.allocator_(subgroup))
   , bijection_(k.bijection_)
+  , fk_tip_link_(NULL)
+  , fk_base_link_(NULL)
+  , analytic_(false)
+  , ik_failures_(new IKFailureMemo())
 {
   state_space_.reset(new ompl::base::SE3StateSpace());
   state_space_->setName(subgroup_->getName() + "_Workspace");
-  fk_link_.resize(1, kinematics_solver_->getTipFrame());
-  if (!fk_link_[0].empty() && fk_link_[0][0] == '/')
-    fk_link_[0] = fk_link_[0].substr(1);
+  fk_link_.resize(1, stripLeadingSlash(kinematics_solver_->getTipFrame()));
+}
+
+void ompl_interface::PoseModelStateSpace::PoseComponent::initializeFK(const robot_model::JointModelGroup *group,
+                                                                      const std::shared_ptr<TSStateStorage> &states)
+{
+  const robot_model::RobotModel &model = group->getParentModel();
+  const std::string base_frame = stripLeadingSlash(kinematics_solver_->getBaseFrame());
+  if (!model.hasLinkModel(fk_link_[0]) ||
+      (!model.hasLinkModel(base_frame) && base_frame != stripLeadingSlash(model.getModelFrame())))
+  {
+    ROS_DEBUG("Frames of the kinematics solver for '%s' are not links of the robot model; computing FK with the solver",
+              subgroup_->getName().c_str());
+    return;
+  }
+  fk_tip_link_ = model.getLinkModel(fk_link_[0]);
+  fk_base_link_ = model.hasLinkModel(base_frame) ? model.getLinkModel(base_frame) : NULL;
+
+  const std::vector<int> &group_variables = group->getVariableIndexList();
+  fk_variables_.resize(bijection_.size());
+  for (std::size_t i = 0 ; i < bijection_.size() ; ++i)
+    fk_variables_[i] = group_variables[bijection_[i]];
+  fk_states_ = states;
 }
 
 bool ompl_interface::PoseModelStateSpace::PoseComponent::computeStateFK(StateType *full_state, unsigned int idx) const
 {
+  ompl::base::SE3StateSpace::StateType *se3_state = full_state->poses[idx];
+
+  if (fk_states_)
+  {
+    // set the joint values in the robot state of this thread; only the links below these joints are updated
+    robot_state::RobotState *rstate = fk_states_->getStateStorage();
+    for (std::size_t i = 0 ; i < fk_variables_.size() ; ++i)
+      rstate->setVariablePosition(fk_variables_[i], full_state->values[bijection_[i]]);
+
+    // the pose of the tip, in the frame of the kinematics solver
+    Eigen::Affine3d pose = fk_base_link_ ?
+      rstate->getGlobalLinkTransform(fk_base_link_).inverse(Eigen::Isometry) * rstate->getGlobalLinkTransform(fk_tip_link_) :
+      rstate->getGlobalLinkTransform(fk_tip_link_);
+
+    se3_state->setXYZ(pose.translation().x(), pose.translation().y(), pose.translation().z());
+    // the transform is rigid, so the linear part is the rotation
+    Eigen::Quaterniond q(pose.linear());
+    ompl::base::SO3StateSpace::StateType &so3_state = se3_state->rotation();
+    so3_state.x = q.x();
+    so3_state.y = q.y();
+    so3_state.z = q.z();
+    so3_state.w = q.w();
+    return true;
+  }
+
   // read the values from the joint state, in the order expected by the kinematics solver
-  std::vector<double> values(bijection_.size());
+  std::vector<double> &values = kinematics_scratch.seed;
+  values.resize(bijection_.size());
   for (unsigned int i = 0 ; i < bijection_.size() ; ++i)
     values[i] = full_state->values[bijection_[i]];
 
@@ -190,7 +407,6 @@ bool ompl_interface::PoseModelStateSpace::PoseComponent::computeStateFK(StateTyp
     return false;
 
   // copy the resulting data to the desired location in the state
-  ompl::base::SE3StateSpace::StateType *se3_state = full_state->poses[idx];
   se3_state->setXYZ(poses[0].position.x, poses[0].position.y, poses[0].position.z);
   ompl::base::SO3StateSpace::StateType &so3_state = se3_state->rotation();
   so3_state.x = poses[0].orientation.x;
@@ -204,7 +420,8 @@ bool ompl_interface::PoseModelStateSpace::PoseComponent::computeStateFK(StateTyp
 bool ompl_interface::PoseModelStateSpace::PoseComponent::computeStateIK(StateType *full_state, unsigned int idx) const
 {
   // read the values from the joint state, in the order expected by the kinematics solver; use these as the seed
-  std::vector<double> seed_values(bijection_.size());
+  std::vector<double> &seed_values = kinematics_scratch.seed;
+  seed_values.resize(bijection_.size());
   for (std::size_t i = 0 ; i < bijection_.size() ; ++i)
     seed_values[i] = full_state->values[bijection_[i]];
 
@@ -227,14 +444,34 @@ bool ompl_interface::PoseModelStateSpace::PoseComponent::computeStateIK(StateTyp
   pose.orientation.z = so3_state.z;
   pose.orientation.w = so3_state.w;
 
-  // run IK
-  std::vector<double> solution(bijection_.size());
+  // poses that failed before during this solve are not tried again; unless the solver is known to be
+  // analytic, it may still succeed from another seed, so its failures are remembered with the seed
+  std::vector<long long> &key = kinematics_scratch.failure_key;
+  makeIKFailureKey(pose, analytic_ ? NULL : &seed_values, key);
+  {
+    boost::mutex::scoped_lock slock(ik_failures_->lock);
+    if (ik_failures_->poses.find(key) != ik_failures_->poses.end())
+    {
+      ik_failures_->hits++;
+      return false;
+    }
+  }
+
+  // run IK; analytic solvers find all solutions at once, so searching does not help them
+  std::vector<double> &solution = kinematics_scratch.solution;
+  solution.resize(bijection_.size());
   moveit_msgs::MoveItErrorCodes err_code;
   if (!kinematics_solver_->getPositionIK(pose, seed_values, solution, err_code))
   {
-    if (err_code.val != moveit_msgs::MoveItErrorCodes::TIMED_OUT ||
+    if (analytic_ || err_code.val != moveit_msgs::MoveItErrorCodes::TIMED_OUT ||
         !kinematics_solver_->searchPositionIK(pose, seed_values, kinematics_solver_->getDefaultTimeout() * 2.0, solution, err_code))
+    {
+      boost::mutex::scoped_lock slock(ik_failures_->lock);
+      if (ik_failures_->poses.size() >= IK_FAILURE_MAX_COUNT)
+        ik_failures_->poses.clear();
+      ik_failures_->poses.insert(key);
       return false;
+    }
   }
 
   for (std::size_t i = 0 ; i < bijection_.size() ; ++i)
@@ -243,16 +480,98 @@ bool ompl_interface::PoseModelStateSpace::PoseComponent::computeStateIK(StateTyp
   return true;
 }
 
+void ompl_interface::PoseModelStateSpace::clearIKFailures()
+{
+  for (std::size_t i = 0 ; i < poses_.size() ; ++i)
+  {
+    boost::mutex::scoped_lock slock(poses_[i].ik_failures_->lock);
+    poses_[i].ik_failures_->poses.clear();
+    poses_[i].ik_failures_->hits = 0;
+  }
+}
+
+std::size_t ompl_interface::PoseModelStateSpace::getIKFailureHits() const
+{
+  std::size_t hits = 0;
+  for (std::size_t i = 0 ; i < poses_.size() ; ++i)
+  {
+    boost::mutex::scoped_lock slock(poses_[i].ik_failures_->lock);
+    hits += poses_[i].ik_failures_->hits;
+  }
+  return hits;
+}
+
+void ompl_interface::PoseModelStateSpace::setAnalyticIK(bool analytic)
+{
+  for (std::size_t i = 0 ; i < poses_.size() ; ++i)
+    poses_[i].analytic_ = analytic;
+}
+
+void ompl_interface::PoseModelStateSpace::setReachabilityMap(const ReachabilityMapConstPtr &map)
+{
+  if (map && (poses_.size() != 1 || map->getTipFrame() != poses_[0].fk_link_[0] ||
+              map->getBaseFrame() != stripLeadingSlash(poses_[0].kinematics_solver_->getBaseFrame())))
+  {
+    ROS_DEBUG("The reachability map of '%s' does not match the kinematics solver of the group; not using it", map->getGroupName().c_str());
+    reachability_map_.reset();
+    return;
+  }
+  reachability_map_ = map;
+}
+
+double ompl_interface::PoseModelStateSpace::getReachabilityScore(const ompl::base::State *state) const
+{
+  if (!reachability_map_)
+    return 1.0;
+  if (!ensurePoseComputed(state))
+    return 0.0;
+  const ompl::base::SE3StateSpace::StateType *se3_state = state->as<StateType>()->poses[0];
+  const ompl::base::SO3StateSpace::StateType &so3_state = se3_state->rotation();
+  Eigen::Affine3d pose(Eigen::Quaterniond(so3_state.w, so3_state.x, so3_state.y, so3_state.z));
+  pose.translation() = Eigen::Vector3d(se3_state->getX(), se3_state->getY(), se3_state->getZ());
+  return reachability_map_->getScore(pose);
+}
+
+bool ompl_interface::PoseModelStateSpace::computeComponents(ComponentFunction fn, StateType *state, bool parallel) const
+{
+  if (!parallel || !components_pool_)
+  {
+    for (std::size_t i = 0 ; i < poses_.size() ; ++i)
+      if (!(poses_[i].*fn)(state, i))
+        return false;
+    return true;
+  }
+
+  boost::atomic<bool> failed(false);
+  components_pool_->run(poses_.size(), boost::bind(&PoseModelStateSpace::computeComponent, this, fn, state, &failed, _1));
+  return !failed;
+}
+
+void ompl_interface::PoseModelStateSpace::computeComponent(ComponentFunction fn, StateType *state, boost::atomic<bool> *failed,
+                                                          unsigned int idx) const
+{
+  if (!(poses_[idx].*fn)(state, idx))
+    *failed = true;
+}
+
 bool ompl_interface::PoseModelStateSpace::computeStateFK(ompl::base::State *state) const
 {
   if (state->as<StateType>()->poseComputed())
     return true;
+
+  // FK on the robot model takes microseconds, less than handing it to another thread; only FK through
+  // the kinematics solvers is worth running concurrently
+  bool parallel = false;
   for (std::size_t i = 0 ; i < poses_.size() ; ++i)
-    if (!poses_[i].computeStateFK(state->as<StateType>(), i))
-    {
-      state->as<StateType>()->markInvalid();
-      return false;
-    }
+    if (!poses_[i].fk_states_)
+      parallel = true;
+
+  if (!computeComponents(&PoseComponent::computeStateFK, state->as<StateType>(), parallel))
+  {
+    state->as<StateType>()->markPoseFailed();
+    state->as<StateType>()->markInvalid();
+    return false;
+  }
   state->as<StateType>()->setPoseComputed(true);
   return true;
 }
@@ -261,12 +580,11 @@ bool ompl_interface::PoseModelStateSpace::computeStateIK(ompl::base::State *stat
 {
   if (state->as<StateType>()->jointsComputed())
     return true;
-  for (std::size_t i = 0 ; i < poses_.size() ; ++i)
-    if (!poses_[i].computeStateIK(state->as<StateType>(), i))
-    {
-      state->as<StateType>()->markInvalid();
-      return false;
-    }
+  if (!computeComponents(&PoseComponent::computeStateIK, state->as<StateType>(), true))
+  {
+    state->as<StateType>()->markInvalid();
+    return false;
+  }
   state->as<StateType>()->setJointsComputed(true);
   return true;
 }
@@ -297,8 +615,16 @@ ompl::base::StateSamplerPtr ompl_interface::PoseModelStateSpace::allocDefaultSta
 
     virtual void sampleUniform(ompl::base::State *state)
     {
-      sampler_->sampleUniform(state);
-      afterStateSample(state);
+      // with a reachability map, samples are accepted with a probability that grows with their score;
+      // poorly scored samples are still accepted sometimes, so no region of the space is excluded
+      const PoseModelStateSpace *space = space_->as<PoseModelStateSpace>();
+      for (unsigned int i = 0 ; ; ++i)
+      {
+        sampler_->sampleUniform(state);
+        afterStateSample(state);
+        if (i + 1 >= REACHABILITY_SAMPLING_ATTEMPTS || rng_.uniform01() < 0.25 + 0.75 * space->getReachabilityScore(state))
+          break;
+      }
     }
 
     virtual void sampleUniformNear(ompl::base::State *state, const ompl::base::State *near, const double distance)
@@ -315,11 +641,12 @@ ompl::base::StateSamplerPtr ompl_interface::PoseModelStateSpace::allocDefaultSta
 
   protected:
 
+    // the poses of the sample are computed when they are first needed, so rejected samples do not pay for FK;
+    // the sample is only used by the sampling thread until it is copied
     void afterStateSample(ompl::base::State *sample) const
     {
       sample->as<StateType>()->setJointsComputed(true);
       sample->as<StateType>()->setPoseComputed(false);
-      space_->as<PoseModelStateSpace>()->computeStateFK(sample);
     }
 
     ompl::base::StateSamplerPtr sampler_;
@@ -334,6 +661,7 @@ void ompl_interface::PoseModelStateSpace::copyToOMPLState(ompl::base::State *sta
   ModelBasedStateSpace::copyToOMPLState(state, rstate);
   state->as<StateType>()->setJointsComputed(true);
   state->as<StateType>()->setPoseComputed(false);
+  // computed eagerly, so an FK failure is known before the validity of the state is checked
   computeStateFK(state);
   /*
   std::cout << "COPY STATE IN:\n";